@@ -0,0 +1,48 @@
+#!/bin/sh
+# Run moonwm against a headless Xvfb server and measure it with loadgen.
+# Options are passed on to loadgen, results are printed as tab separated
+# values with the moonwm statistics appended as comments.
+# "bench.sh replay [-t] FILE" replays an event recording instead and
+# "bench.sh keylat [BINDING...]" measures key bindings from press to screen.
+
+BENCH_DIR="$(cd "$(dirname "$0")" && pwd)"
+TOP_DIR="$(dirname "$BENCH_DIR")"
+BENCH_DISPLAY="${BENCH_DISPLAY:-:99}"
+BENCH_HOME="$(mktemp -d)"
+
+cleanup () {
+	[ -n "$WM_PID" ] && kill "$WM_PID" 2> /dev/null
+	[ -n "$XVFB_PID" ] && kill "$XVFB_PID" 2> /dev/null
+	rm -rf "$BENCH_HOME"
+}
+trap cleanup EXIT INT TERM
+
+# isolated configuration, so no user settings or autostart scripts get in the way
+mkdir -p "$BENCH_HOME/.config/moonwm"
+echo "moonwm.stats: 1" > "$BENCH_HOME/.config/moonwm/config.xres"
+unset XDG_CONFIG_HOME XDG_DATA_HOME MOONWM_LAUNCH_STATUS
+export HOME="$BENCH_HOME"
+export DISPLAY="$BENCH_DISPLAY"
+export PATH="$TOP_DIR:$PATH"
+
+Xvfb "$DISPLAY" -screen 0 1920x1080x24 -nolisten tcp > /dev/null 2>&1 &
+XVFB_PID="$!"
+sleep 0.5
+moonwm > "$BENCH_HOME/moonwm.log" 2>&1 &
+WM_PID="$!"
+
+if ! "$BENCH_DIR/loadgen" -w; then
+	echo "bench: moonwm did not start:" >&2
+	cat "$BENCH_HOME/moonwm.log" >&2
+	exit 1
+fi
+
+echo "# commit	$(git -C "$TOP_DIR" describe --always --dirty 2> /dev/null || echo unknown)"
+if [ "$1" = replay ] || [ "$1" = keylat ]; then
+	TOOL="$1"
+	shift
+	"$BENCH_DIR/$TOOL" "$@" || exit 1
+else
+	"$BENCH_DIR/loadgen" "$@" || exit 1
+fi
+moonctl stats | sed 's/^#* */# /'
@@ -0,0 +1,233 @@
+/* vim: set noet: */
+/* keylat - keypress to screen latency of moonwm key bindings (see bench.sh)
+ *
+ * Presses key bindings through XTest and waits until moonwm handled
+ * everything they caused.  The latency seen by this client, from sending
+ * the key press until moonwm answered, is reported per binding as tab
+ * separated values in microseconds.  With moonwm.stats enabled moonwm
+ * measures itself from keypress() until the server processed the
+ * resulting configures and bar drawing, see the key: lines of
+ * moonctl stats. */
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XTest.h>
+
+#define TIMEOUT			(1000) /* ms to wait for moonwm to react */
+#define LENGTH(X)		(sizeof X / sizeof X[0])
+#define MAXKEYS			(8) /* keys in a binding including modifiers */
+
+typedef struct {
+	const char *spec;
+	KeyCode keys[MAXKEYS];
+	int nkeys;
+	long long *samples;
+	int n;
+} Binding;
+
+static void die(const char *msg);
+static long long now(void);
+static void parse(Binding *b, const char *modkey);
+static void press(const Binding *b);
+static void printbindings(void);
+static void syncwm(void);
+static void usage(void);
+static int waitfor(int type, Window win);
+
+static Display *dpy;
+static Window root, probe;
+static int probex;
+static Binding *bindings;
+static int nbindings;
+/* bindings of the default configuration that don't spawn anything */
+static const char *defaults[] = {
+	"mod+space", "mod+2", "mod+1", "mod+m", "mod+t", "mod+a", "mod+x", "mod+Tab",
+};
+
+
+void
+die(const char *msg)
+{
+	fprintf(stderr, "keylat: %s\n", msg);
+	exit(EXIT_FAILURE);
+}
+
+long long
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+/* turn a spec like "mod+shift+Tab" into the keycodes to press */
+void
+parse(Binding *b, const char *modkey)
+{
+	char buf[128], *tok, *save;
+	KeySym sym;
+
+	snprintf(buf, sizeof(buf), "%s", b->spec);
+	for (tok = strtok_r(buf, "+", &save); tok; tok = strtok_r(NULL, "+", &save)) {
+		if (!strcasecmp(tok, "mod"))
+			tok = (char *)modkey;
+		if (!strcasecmp(tok, "alt"))
+			sym = XK_Alt_L;
+		else if (!strcasecmp(tok, "super"))
+			sym = XK_Super_L;
+		else if (!strcasecmp(tok, "shift"))
+			sym = XK_Shift_L;
+		else if (!strcasecmp(tok, "control") || !strcasecmp(tok, "ctrl"))
+			sym = XK_Control_L;
+		else
+			sym = XStringToKeysym(tok);
+		if (sym == NoSymbol || b->nkeys == MAXKEYS
+				|| !(b->keys[b->nkeys++] = XKeysymToKeycode(dpy, sym))) {
+			fprintf(stderr, "keylat: invalid key binding: %s\n", b->spec);
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+/* press the keys in order and release them in reverse */
+void
+press(const Binding *b)
+{
+	int i;
+
+	for (i = 0; i < b->nkeys; i++)
+		XTestFakeKeyEvent(dpy, b->keys[i], True, CurrentTime);
+	for (i = b->nkeys - 1; i >= 0; i--)
+		XTestFakeKeyEvent(dpy, b->keys[i], False, CurrentTime);
+	XFlush(dpy);
+}
+
+void
+printbindings(void)
+{
+	Binding *b;
+	int i, j, k;
+	long long x, sum;
+
+	printf("# binding\tcount\tmean_us\tp50_us\tp99_us\tmax_us\n");
+	for (i = 0; i < nbindings; i++) {
+		b = &bindings[i];
+		if (!b->n)
+			continue;
+		/* insertion sort, there are only a few hundred samples */
+		for (j = 1, sum = b->samples[0]; j < b->n; j++) {
+			x = b->samples[j];
+			sum += x;
+			for (k = j; k > 0 && b->samples[k - 1] > x; k--)
+				b->samples[k] = b->samples[k - 1];
+			b->samples[k] = x;
+		}
+		printf("%s\t%d\t%lld\t%lld\t%lld\t%lld\n", b->spec, b->n, sum / b->n,
+				b->samples[b->n / 2], b->samples[(b->n * 99) / 100], b->samples[b->n - 1]);
+	}
+}
+
+/* wait until moonwm handled everything sent so far: configure requests of
+ * unmanaged windows get passed on by moonwm in order with everything else */
+void
+syncwm(void)
+{
+	XMoveWindow(dpy, probe, probex++ % 2, 0);
+	XFlush(dpy);
+	if (!waitfor(ConfigureNotify, probe))
+		die("moonwm does not respond");
+}
+
+void
+usage(void)
+{
+	fputs("usage: keylat [-m modkey] [-n windows] [-r rounds] [binding ...]\n", stderr);
+	exit(EXIT_FAILURE);
+}
+
+int
+waitfor(int type, Window win)
+{
+	struct pollfd pfd = { .fd = ConnectionNumber(dpy), .events = POLLIN };
+	long long deadline = now() + TIMEOUT * 1000LL;
+	XEvent ev;
+
+	while (now() < deadline) {
+		while (XPending(dpy)) {
+			XNextEvent(dpy, &ev);
+			if (ev.type == type && ev.xany.window == win && !ev.xany.send_event)
+				return 1;
+		}
+		poll(&pfd, 1, (deadline - now()) / 1000 + 1);
+	}
+	return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	XSetWindowAttributes wa = { .event_mask = StructureNotifyMask };
+	const char *modkey = "alt";
+	int i, j, opt, event, error, major, minor, rounds = 100, n = 8;
+	long long t;
+	Window win;
+
+	while ((opt = getopt(argc, argv, "m:n:r:")) != -1) {
+		switch (opt) {
+		case 'm': modkey = optarg; break;
+		case 'n': n = atoi(optarg); break;
+		case 'r': rounds = atoi(optarg); break;
+		default: usage();
+		}
+	}
+	if (n < 0 || rounds < 1)
+		usage();
+	if (!(dpy = XOpenDisplay(NULL)))
+		die("unable to open display");
+	if (!XTestQueryExtension(dpy, &event, &error, &major, &minor))
+		die("the XTest extension is not available");
+	root = DefaultRootWindow(dpy);
+
+	nbindings = optind < argc ? argc - optind : (int)LENGTH(defaults);
+	if (!(bindings = calloc(nbindings, sizeof(Binding))))
+		die("calloc failed");
+	for (i = 0; i < nbindings; i++) {
+		bindings[i].spec = optind < argc ? argv[optind + i] : defaults[i];
+		parse(&bindings[i], modkey);
+		if (!(bindings[i].samples = calloc(rounds, sizeof(long long))))
+			die("calloc failed");
+	}
+
+	/* give the bindings something to lay out */
+	probe = XCreateWindow(dpy, root, 0, 0, 1, 1, 0, CopyFromParent,
+			InputOnly, CopyFromParent, CWEventMask, &wa);
+	for (i = 0; i < n; i++) {
+		win = XCreateWindow(dpy, root, 0, 0, 300, 200, 0, CopyFromParent,
+				InputOutput, CopyFromParent, CWEventMask, &wa);
+		XStoreName(dpy, win, "keylat");
+		XMapWindow(dpy, win);
+		if (!waitfor(MapNotify, win))
+			die("window did not get mapped");
+	}
+	syncwm();
+
+	for (i = 0; i < rounds; i++) {
+		for (j = 0; j < nbindings; j++) {
+			t = now();
+			press(&bindings[j]);
+			syncwm();
+			bindings[j].samples[bindings[j].n++] = now() - t;
+		}
+	}
+
+	printbindings();
+	XCloseDisplay(dpy);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,307 @@
+/* vim: set noet: */
+/* loadgen - synthetic client load for benchmarking moonwm (see bench.sh)
+ *
+ * Creates windows, floods them with title changes and configure requests
+ * and drives moonwm through the same root window name signals moonctl
+ * uses.  Every measurement waits for the effect it is supposed to have,
+ * latencies are reported as tab separated values in microseconds and
+ * throughput as caused events (signals, title changes, configure
+ * requests) per second. */
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#define SIGPREFIX		"fsignal:"
+#define TIMEOUT			(1000) /* ms to wait for moonwm to react */
+#define LENGTH(X)		(sizeof X / sizeof X[0])
+
+typedef struct {
+	const char *name;
+	long long *samples;
+	int n, size;
+	long long total, events; /* wall time in microseconds and events caused, for throughput */
+} Metric;
+
+enum { MetManage, MetUnmanage, MetTagSwitch, MetFocus, MetRelayout,
+	MetTitles, MetConfigures, MetLast };
+
+static void die(const char *msg);
+static int loadwindows(int n);
+static long long now(void);
+static void ping(void);
+static void printmetrics(void);
+static void record(int metric, long long start, long long end, int events);
+static void sendsignal(const char *command);
+static void usage(void);
+static int waitfor(int type, Window win, Atom atom, int count);
+static int waitwm(void);
+
+static Display *dpy;
+static Window root;
+static Atom activewindow, currenttags, stats;
+static Window *wins;
+static int nwins;
+static Metric metrics[MetLast] = {
+	[MetManage] = { "manage" },
+	[MetUnmanage] = { "unmanage" },
+	[MetTagSwitch] = { "tagswitch" },
+	[MetFocus] = { "focuscycle" },
+	[MetRelayout] = { "relayout" },
+	[MetTitles] = { "titleflood" },
+	[MetConfigures] = { "configureflood" },
+};
+
+
+void
+die(const char *msg)
+{
+	fprintf(stderr, "loadgen: %s\n", msg);
+	exit(EXIT_FAILURE);
+}
+
+/* create and map n windows, half of them on tag 1 and half on tag 2 */
+int
+loadwindows(int n)
+{
+	XSetWindowAttributes wa = { .event_mask = StructureNotifyMask|PropertyChangeMask };
+	long long t;
+	int i;
+
+	if (!(wins = calloc(n, sizeof(Window))))
+		die("calloc failed");
+	for (i = 0; i < n; i++) {
+		if (i == n / 2) {
+			sendsignal("view ui 2");
+			waitfor(PropertyNotify, root, currenttags, 1);
+		}
+		wins[i] = XCreateWindow(dpy, root, 0, 0, 300, 200, 0, CopyFromParent,
+				InputOutput, CopyFromParent, CWEventMask, &wa);
+		XStoreName(dpy, wins[i], "loadgen");
+		t = now();
+		XMapWindow(dpy, wins[i]);
+		if (!waitfor(MapNotify, wins[i], None, 1))
+			return 0;
+		record(MetManage, t, now(), 1);
+		nwins++;
+	}
+	sendsignal("view ui 1");
+	waitfor(PropertyNotify, root, currenttags, 1);
+	return 1;
+}
+
+long long
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+/* wait until moonwm processed everything sent so far, signals are handled in order */
+void
+ping(void)
+{
+	sendsignal("stats i 0");
+	if (!waitfor(PropertyNotify, root, stats, 1))
+		die("moonwm does not respond");
+}
+
+void
+printmetrics(void)
+{
+	Metric *m;
+	int i, j, k;
+	long long x, sum;
+
+	printf("# metric\tcount\tmean_us\tp50_us\tp99_us\tmax_us\tper_second\n");
+	for (i = 0; i < MetLast; i++) {
+		m = &metrics[i];
+		if (!m->n)
+			continue;
+		/* insertion sort, there are only a few hundred samples */
+		for (j = 1, sum = m->samples[0]; j < m->n; j++) {
+			x = m->samples[j];
+			sum += x;
+			for (k = j; k > 0 && m->samples[k - 1] > x; k--)
+				m->samples[k] = m->samples[k - 1];
+			m->samples[k] = x;
+		}
+		printf("%s\t%d\t%lld\t%lld\t%lld\t%lld\t%.1f\n", m->name, m->n, sum / m->n,
+				m->samples[m->n / 2], m->samples[(m->n * 99) / 100], m->samples[m->n - 1],
+				m->total ? m->events * 1000000.0 / m->total : 0.0);
+	}
+}
+
+void
+record(int metric, long long start, long long end, int events)
+{
+	Metric *m = &metrics[metric];
+
+	if (m->n == m->size) {
+		m->size = m->size ? m->size * 2 : 64;
+		if (!(m->samples = realloc(m->samples, m->size * sizeof(long long))))
+			die("realloc failed");
+	}
+	m->samples[m->n++] = end - start;
+	m->total += end - start;
+	m->events += events;
+}
+
+void
+sendsignal(const char *command)
+{
+	char buf[128];
+
+	snprintf(buf, sizeof(buf), "%s%s", SIGPREFIX, command);
+	XStoreName(dpy, root, buf);
+	XFlush(dpy);
+}
+
+void
+usage(void)
+{
+	fputs("usage: loadgen [-w] [-n windows] [-r rounds] [-t titles]\n", stderr);
+	exit(EXIT_FAILURE);
+}
+
+/* wait for count events of the given type on win (any of our windows if None),
+ * PropertyNotify also has to match atom, returns the number of events seen */
+int
+waitfor(int type, Window win, Atom atom, int count)
+{
+	struct pollfd pfd = { .fd = ConnectionNumber(dpy), .events = POLLIN };
+	long long deadline = now() + TIMEOUT * 1000LL;
+	XEvent ev;
+	int seen = 0;
+
+	while (seen < count) {
+		while (seen < count && XPending(dpy)) {
+			XNextEvent(dpy, &ev);
+			if (ev.type != type || (win && ev.xany.window != win) || ev.xany.send_event)
+				continue;
+			if (type == PropertyNotify && ev.xproperty.atom != atom)
+				continue;
+			seen++;
+		}
+		if (seen == count || now() >= deadline)
+			break;
+		poll(&pfd, 1, (deadline - now()) / 1000 + 1);
+	}
+	return seen;
+}
+
+/* wait until the display is up and moonwm runs on it */
+int
+waitwm(void)
+{
+	Atom type;
+	int i, format;
+	unsigned long n, extra;
+	unsigned char *p = NULL;
+
+	for (i = 0; i < 50; i++, usleep(100000)) {
+		if (!dpy && !(dpy = XOpenDisplay(NULL)))
+			continue;
+		if (XGetWindowProperty(dpy, DefaultRootWindow(dpy), XInternAtom(dpy, "_NET_SUPPORTING_WM_CHECK", False),
+				0, 1, False, XA_WINDOW, &type, &format, &n, &extra, &p) == Success && p) {
+			XFree(p);
+			if (n)
+				return 1;
+		}
+	}
+	return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int i, j, opt, onlywait = 0, rounds = 100, titles = 50, n = 20;
+	char buf[64];
+	long long t;
+
+	while ((opt = getopt(argc, argv, "wn:r:t:")) != -1) {
+		switch (opt) {
+		case 'w': onlywait = 1; break;
+		case 'n': n = atoi(optarg); break;
+		case 'r': rounds = atoi(optarg); break;
+		case 't': titles = atoi(optarg); break;
+		default: usage();
+		}
+	}
+	if (n < 4 || rounds < 1 || titles < 1)
+		usage();
+	if (!waitwm())
+		die("no window manager running");
+	if (onlywait)
+		return EXIT_SUCCESS;
+
+	root = DefaultRootWindow(dpy);
+	activewindow = XInternAtom(dpy, "_NET_ACTIVE_WINDOW", False);
+	currenttags = XInternAtom(dpy, "_MWM_CURRENT_TAGS", False);
+	stats = XInternAtom(dpy, "_MWM_STATS", False);
+	XSelectInput(dpy, root, PropertyChangeMask);
+	sendsignal("view ui 1");
+	waitfor(PropertyNotify, root, currenttags, 1);
+
+	if (!loadwindows(n))
+		die("window did not get mapped");
+
+	for (i = 0; i < rounds; i++) {
+		snprintf(buf, sizeof(buf), "view ui %d", i % 2 ? 1 : 2);
+		t = now();
+		sendsignal(buf);
+		if (waitfor(PropertyNotify, root, currenttags, 1))
+			record(MetTagSwitch, t, now(), 1);
+	}
+
+	for (i = 0; i < rounds; i++) {
+		t = now();
+		sendsignal("focusstack i 1");
+		if (waitfor(PropertyNotify, root, activewindow, 1))
+			record(MetFocus, t, now(), 1);
+	}
+
+	ping();
+	for (i = 0; i < rounds; i++) {
+		t = now();
+		sendsignal(i % 2 ? "setmfact f 1.55" : "setmfact f 1.40");
+		if (waitfor(ConfigureNotify, None, None, n / 2) == n / 2)
+			record(MetRelayout, t, now(), 1);
+	}
+
+	for (i = 0; i < rounds; i++) {
+		t = now();
+		for (j = 0; j < titles; j++) {
+			snprintf(buf, sizeof(buf), "loadgen %d/%d", i, j);
+			XStoreName(dpy, wins[j % nwins], buf);
+		}
+		ping();
+		record(MetTitles, t, now(), titles);
+	}
+
+	for (i = 0; i < rounds; i++) {
+		t = now();
+		for (j = 0; j < nwins; j++)
+			XMoveResizeWindow(dpy, wins[j], i + j, i + j, 200 + i, 100 + j);
+		ping();
+		record(MetConfigures, t, now(), nwins);
+	}
+
+	for (i = 0; i < nwins; i++) {
+		t = now();
+		XUnmapWindow(dpy, wins[i]);
+		ping();
+		record(MetUnmanage, t, now(), 1);
+	}
+
+	printmetrics();
+	XCloseDisplay(dpy);
+	return EXIT_SUCCESS;
+}
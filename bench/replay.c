@@ -0,0 +1,413 @@
+/* vim: set noet: */
+/* replay - re-enact an event recording of moonwm (see moonctl record)
+ *
+ * The recorded windows are recreated with their properties and the
+ * client side of every recorded event is done again: windows get mapped,
+ * configured, unmapped and destroyed, properties and the root window
+ * name (and with that moonctl signals) are set and client messages are
+ * sent.  Pointer motion is replayed by warping the pointer.  Key and
+ * button events are skipped, as are events moonwm caused itself.
+ * moonwm is synced with after every signal, so it handles the same
+ * sequence it handled while recording. */
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#define RECORD_READONLY
+#include "../src/record.h"
+
+#define MAX(A, B)		((A) > (B) ? (A) : (B))
+#define TIMEOUT			(1000) /* ms to wait for moonwm to react */
+
+typedef struct {
+	const unsigned char *p, *end;
+} Reader;
+
+typedef struct {
+	uint64_t from;
+	Window to;
+} WinMap;
+
+static void die(const char *msg);
+static int get(Reader *c, void *dst, size_t len);
+static int getstr(Reader *c, char *buf, size_t size);
+static Window lookup(uint64_t win, int create);
+static long long now(void);
+static void replay(const RecordHeader *h, Reader *c);
+static void replayconfigure(Window win, Reader *c);
+static void replaymessage(Window win, Reader *c);
+static void replayprop(Window win, uint32_t state, Reader *c);
+static void replaywindow(Window win, Reader *c);
+static void syncwm(void);
+static void unmapwin(uint64_t win);
+static void usage(void);
+static int waitfor(int type, Window win);
+
+static Display *dpy;
+static Window root, probe;
+static WinMap *wins;
+static int nwins, winssize, probex;
+static unsigned long replayed[RecordWindow + 1], skipped[RecordWindow + 1];
+static const char *names[RecordWindow + 1] = {
+	[KeyPress] = "KeyPress", [KeyRelease] = "KeyRelease",
+	[ButtonPress] = "ButtonPress", [ButtonRelease] = "ButtonRelease",
+	[MotionNotify] = "MotionNotify", [EnterNotify] = "EnterNotify",
+	[LeaveNotify] = "LeaveNotify", [FocusIn] = "FocusIn", [FocusOut] = "FocusOut",
+	[Expose] = "Expose", [DestroyNotify] = "DestroyNotify",
+	[UnmapNotify] = "UnmapNotify", [MapNotify] = "MapNotify",
+	[MapRequest] = "MapRequest", [ConfigureNotify] = "ConfigureNotify",
+	[ConfigureRequest] = "ConfigureRequest", [PropertyNotify] = "PropertyNotify",
+	[ClientMessage] = "ClientMessage", [MappingNotify] = "MappingNotify",
+	[RecordWindow] = "initial window",
+};
+
+
+void
+die(const char *msg)
+{
+	fprintf(stderr, "replay: %s\n", msg);
+	exit(EXIT_FAILURE);
+}
+
+int
+get(Reader *c, void *dst, size_t len)
+{
+	if ((size_t)(c->end - c->p) < len)
+		return 0;
+	memcpy(dst, c->p, len);
+	c->p += len;
+	return 1;
+}
+
+int
+getstr(Reader *c, char *buf, size_t size)
+{
+	uint16_t len;
+
+	if (!get(c, &len, sizeof(len)) || len >= size || !get(c, buf, len))
+		return 0;
+	buf[len] = '\0';
+	return 1;
+}
+
+/* window replaying the recorded one, root stays root */
+Window
+lookup(uint64_t win, int create)
+{
+	XSetWindowAttributes wa = { .event_mask = StructureNotifyMask };
+	int i;
+
+	if (win == 0 || win == root)
+		return win;
+	for (i = 0; i < nwins; i++)
+		if (wins[i].from == win)
+			return wins[i].to;
+	if (!create)
+		return None;
+	if (nwins == winssize) {
+		winssize = winssize ? winssize * 2 : 64;
+		if (!(wins = realloc(wins, winssize * sizeof(WinMap))))
+			die("realloc failed");
+	}
+	wins[nwins].from = win;
+	wins[nwins].to = XCreateWindow(dpy, root, 0, 0, 100, 100, 0, CopyFromParent,
+			InputOutput, CopyFromParent, CWEventMask, &wa);
+	return wins[nwins++].to;
+}
+
+long long
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+void
+replay(const RecordHeader *h, Reader *c)
+{
+	RecordInput ri;
+	uint32_t state;
+	Window win;
+	int known = h->window == root || lookup(h->window, 0);
+
+	switch (h->type) {
+	case RecordWindow:
+	case MapRequest:
+		if (h->type == MapRequest && known)
+			break;
+		replaywindow(lookup(h->window, 1), c);
+		if (h->type == MapRequest)
+			XMapWindow(dpy, lookup(h->window, 0));
+		break;
+	case ConfigureRequest:
+		if (!known)
+			goto skip;
+		replayconfigure(lookup(h->window, 0), c);
+		break;
+	case PropertyNotify:
+		if (!known || !get(c, &state, sizeof(state)))
+			goto skip;
+		replayprop(lookup(h->window, 0), state, c);
+		break;
+	case ClientMessage:
+		if (!known)
+			goto skip;
+		replaymessage(lookup(h->window, 0), c);
+		break;
+	case UnmapNotify:
+		if (!known)
+			goto skip;
+		unmapwin(h->window);
+		break;
+	case DestroyNotify:
+		if (!known || !(win = lookup(h->window, 0)) || win == root)
+			goto skip;
+		XDestroyWindow(dpy, win);
+		for (int i = 0; i < nwins; i++)
+			if (wins[i].from == h->window)
+				wins[i] = wins[--nwins];
+		break;
+	case MotionNotify:
+	case EnterNotify:
+		if (!get(c, &ri, sizeof(ri)))
+			goto skip;
+		XWarpPointer(dpy, None, root, 0, 0, 0, 0, ri.x, ri.y);
+		break;
+	default:
+		goto skip;
+	}
+	replayed[h->type]++;
+	return;
+skip:
+	skipped[h->type]++;
+}
+
+void
+replayconfigure(Window win, Reader *c)
+{
+	RecordConfigure rc;
+	XWindowChanges wc;
+
+	if (!get(c, &rc, sizeof(rc)))
+		return;
+	wc = (XWindowChanges){ rc.x, rc.y, rc.w, rc.h, rc.bw, lookup(rc.above, 0), rc.detail };
+	if (!wc.sibling)
+		rc.mask &= ~CWSibling;
+	XConfigureWindow(dpy, win, rc.mask, &wc);
+}
+
+void
+replaymessage(Window win, Reader *c)
+{
+	XEvent ev = { .xclient = { .type = ClientMessage, .window = win } };
+	char name[256];
+	uint32_t format;
+	int64_t data[5];
+	int i;
+
+	if (!getstr(c, name, sizeof(name)) || !get(c, &format, sizeof(format))
+			|| !get(c, data, sizeof(data)))
+		return;
+	ev.xclient.message_type = XInternAtom(dpy, name, False);
+	ev.xclient.format = format;
+	for (i = 0; i < 5; i++)
+		ev.xclient.data.l[i] = data[i];
+	/* atoms of _NET_WM_STATE messages */
+	for (i = 1; i <= 2; i++)
+		if (getstr(c, name, sizeof(name)) && name[0])
+			ev.xclient.data.l[i] = XInternAtom(dpy, name, False);
+	XSendEvent(dpy, root, False, SubstructureNotifyMask|SubstructureRedirectMask, &ev);
+}
+
+void
+replayprop(Window win, uint32_t state, Reader *c)
+{
+	char name[256], type[256];
+	uint32_t format, len;
+	unsigned char *data;
+	Atom prop, *atoms;
+	size_t n = 0, i;
+	char *s;
+
+	if (!getstr(c, name, sizeof(name))
+			|| !getstr(c, type, sizeof(type)) || !get(c, &format, sizeof(format))
+			|| !get(c, &len, sizeof(len)) || (size_t)(c->end - c->p) < len)
+		return;
+	data = (unsigned char *)c->p;
+	c->p += len;
+	prop = XInternAtom(dpy, name, False);
+	if (state == PropertyDelete || !type[0]) {
+		XDeleteProperty(dpy, win, prop);
+		return;
+	}
+	if (win == root && prop == XA_WM_NAME && len >= 14 && !strncmp((char *)data, "fsignal:record", 14))
+		return; /* stopping the recording itself */
+
+	if (strcmp(type, "ATOM") == 0) {
+		if (!(atoms = calloc(len + 1, sizeof(Atom))))
+			die("calloc failed");
+		for (s = (char *)data; s < (char *)data + len; s += strlen(s) + 1)
+			atoms[n++] = XInternAtom(dpy, s, False);
+		XChangeProperty(dpy, win, prop, XA_ATOM, 32, PropModeReplace, (unsigned char *)atoms, n);
+		free(atoms);
+	} else if (format == 32) {
+		if (strcmp(type, "WINDOW") == 0)
+			for (i = 0; i < len / sizeof(long); i++)
+				((long *)data)[i] = lookup(((long *)data)[i], 0);
+		XChangeProperty(dpy, win, prop, XInternAtom(dpy, type, False), 32,
+				PropModeReplace, data, len / sizeof(long));
+	} else if (format == 8 || format == 16) {
+		XChangeProperty(dpy, win, prop, XInternAtom(dpy, type, False), format,
+				PropModeReplace, data, len / (format / 8));
+	}
+	if (win == root && prop == XA_WM_NAME)
+		syncwm();
+}
+
+/* recreate the state of a recorded window */
+void
+replaywindow(Window win, Reader *c)
+{
+	RecordGeom g;
+	uint32_t n;
+
+	if (!get(c, &g, sizeof(g)) || !get(c, &n, sizeof(n)))
+		return;
+	if (win != root)
+		XMoveResizeWindow(dpy, win, g.x, g.y, MAX(g.w, 1), MAX(g.h, 1));
+	while (n--)
+		replayprop(win, PropertyNewValue, c);
+	if (win != root && g.mapped) {
+		XMapWindow(dpy, win);
+		waitfor(MapNotify, win);
+	}
+}
+
+/* wait until moonwm handled all requests sent so far: configure requests of
+ * unmanaged windows get passed on by moonwm in order with everything else */
+void
+syncwm(void)
+{
+	XMoveWindow(dpy, probe, probex++ % 2, 0);
+	XFlush(dpy);
+	if (!waitfor(ConfigureNotify, probe))
+		die("moonwm does not respond");
+}
+
+void
+unmapwin(uint64_t win)
+{
+	XWindowAttributes wa;
+	Window w = lookup(win, 0);
+
+	/* moonwm may have hidden the window already itself */
+	if (w && w != root && XGetWindowAttributes(dpy, w, &wa) && wa.map_state != IsUnmapped)
+		XUnmapWindow(dpy, w);
+}
+
+void
+usage(void)
+{
+	fputs("usage: replay [-t] file\n", stderr);
+	exit(EXIT_FAILURE);
+}
+
+int
+waitfor(int type, Window win)
+{
+	struct pollfd pfd = { .fd = ConnectionNumber(dpy), .events = POLLIN };
+	long long deadline = now() + TIMEOUT * 1000LL;
+	XEvent ev;
+
+	while (now() < deadline) {
+		while (XPending(dpy)) {
+			XNextEvent(dpy, &ev);
+			if (ev.type == type && ev.xany.window == win && !ev.xany.send_event)
+				return 1;
+		}
+		poll(&pfd, 1, (deadline - now()) / 1000 + 1);
+	}
+	return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	XSetWindowAttributes wa = { .event_mask = StructureNotifyMask };
+	RecordHeader h;
+	uint32_t header[2];
+	unsigned char *payload = NULL;
+	size_t payloadsize = 0;
+	long long start = 0, t;
+	int i, opt, timed = 0;
+	unsigned long total = 0, nskipped = 0;
+	Reader c;
+	FILE *f;
+
+	while ((opt = getopt(argc, argv, "t")) != -1) {
+		switch (opt) {
+		case 't': timed = 1; break;
+		default: usage();
+		}
+	}
+	if (optind != argc - 1)
+		usage();
+	if (!(f = fopen(argv[optind], "r")))
+		die("unable to open recording");
+	if (fread(header, sizeof(header), 1, f) != 1 || header[0] != RECORDMAGIC)
+		die("not a moonwm recording (or recorded on a machine with another byte order)");
+	if (header[1] != RECORDVERSION)
+		die("unsupported recording version");
+	if (!(dpy = XOpenDisplay(NULL)))
+		die("unable to open display");
+	root = DefaultRootWindow(dpy);
+	probe = XCreateWindow(dpy, root, 0, 0, 1, 1, 0, CopyFromParent,
+			InputOnly, CopyFromParent, CWEventMask, &wa);
+
+	while (fread(&h, sizeof(h), 1, f) == 1) {
+		if (h.size > payloadsize && !(payload = realloc(payload, payloadsize = h.size)))
+			die("realloc failed");
+		if (h.size && fread(payload, h.size, 1, f) != 1)
+			die("truncated recording");
+		if (h.type > RecordWindow)
+			die("corrupt recording");
+		c = (Reader){ payload, payload + h.size };
+		if (h.type != RecordWindow && !start) {
+			/* initial state is set up, measure from here on */
+			syncwm();
+			XStoreName(dpy, root, "fsignal:stats i 1");
+			syncwm();
+			start = now();
+		}
+		if (timed && start && (t = start + h.time - now()) > 0)
+			usleep(t);
+		replay(&h, &c);
+	}
+	syncwm();
+	t = now() - start;
+
+	for (i = 0; i <= RecordWindow; i++) {
+		total += replayed[i] + skipped[i];
+		nskipped += skipped[i];
+	}
+	printf("# records\treplayed\tskipped\tseconds\treplayed_per_second\n");
+	printf("replay\t%lu\t%lu\t%lu\t%.3f\t%.1f\n", total, total - nskipped, nskipped,
+			t / 1e6, t ? (total - nskipped) * 1e6 / t : 0.0);
+	printf("# type\treplayed\tskipped\n");
+	for (i = 0; i <= RecordWindow; i++)
+		if (replayed[i] || skipped[i])
+			printf("# %s\t%lu\t%lu\n", names[i] ? names[i] : "other", replayed[i], skipped[i]);
+	fclose(f);
+	free(payload);
+	XCloseDisplay(dpy);
+	return EXIT_SUCCESS;
+}
@@ -67,11 +67,18 @@
 #define M_TERMINAL		(1 << 11)
 #define M_URGENT		(1 << 12)
 #define M_BORROWED		(1 << 13)
+#define M_MAPPED		(1 << 14)	/* map state last requested by moonwm */
+#define M_PARK			(1 << 15)	/* park off-screen instead of unmapping when hidden */
+#define M_TRAYDIRTY		(1 << 16)	/* systray icon needs to be configured again */
+#define M_TITLEDIRTY	(1 << 17)	/* title changed but has not been fetched yet */
 
 
 /* enums */
 enum { CurNormal, CurResize, CurMove, CurLast }; /* cursor */
 enum { SchemeNorm, SchemeHigh }; /* color schemes */
+enum { GrabNone, GrabUnfocused, GrabFocused }; /* button grabs installed on a client */
+enum { DeferBars = 1 << 0, DeferStatus = 1 << 1, DeferTray = 1 << 2,
+	DeferTitles = 1 << 3 }; /* work held back in game mode */
 
 
 /* structs */
@@ -105,6 +112,12 @@ struct Client {
 	unsigned int tags;
 	unsigned int origtags;
 	int props;
+	int grabs; /* button grabs currently installed on win */
+	long long parked; /* time the client got parked off-screen, 0 if it is not */
+	long long titletime; /* time the title got fetched last */
+	unsigned long long cfghash; /* last configure request, to detect loops */
+	long long cfgtime;
+	unsigned int cfgrepeats;
 	pid_t pid;
 	Client *next;
 	Client *snext;
@@ -145,6 +158,8 @@ typedef struct {
 typedef struct {
 	Window win;
 	Client *icons;
+	int x, y, w;	/* geometry last configured, w is the cached width of the icons */
+	int dirty;		/* configure and repaint the tray window on the next update */
 } Systray;
 
 
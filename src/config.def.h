@@ -22,6 +22,8 @@ static int smartgaps                = 1;        /* 1 means no outer gap when the
 static unsigned int defaultlayout	= 0;        /* index of the default layout */
 static const unsigned int systraypinning = 1;   /* 0: sloppy systray follows selected monitor, >0: pin systray to monitor X */
 static const unsigned int systrayspacing = 2;   /* systray spacing */
+static const unsigned int cfgrepeats = 3;       /* identical configure requests of a tiled client answered in a row... */
+static const unsigned int cfgwindow = 250;      /* ...if less than this many ms apart, further ones are ignored */
 static const int systraypinningfailfirst = 1;   /* 1: if pinning fails, display systray on the first monitor, False: display systray on the last monitor*/
 static int showsystray      = 1;	/* 0 means no systray */
 static int showbar          = 1;    /* 0 means no bar */
@@ -37,10 +39,26 @@ static const int istatustimeout     = 10;       /* max timeout before displaying
 static const int riodraw_borders    = 0;        /* 0 or 1, indicates whether the area drawn using slop includes the window borders */
 static const int riodraw_matchpid   = 0;        /* 0 or 1, indicates whether to match the PID of the client that was spawned with riospawn */
 static const int riodraw_spawnasync = 1;        /* 0 means that the application is only spawned after a successful selection while
-												 * 1 means that the application is being initialised in the background while the selection is made */
+												 * 1 means that the application is being initialised in the background while the selection is made,
+												 * windows mapped during the selection are then always matched by PID */
 static const int center_relbar		= 1;		/* 1 means centering applications relative to the bar when using center() or spawning new windows */
 static int wraparound				= 0;		/* wrap around screenedges in focusdir, movedir */
 static int workspaces               = 0;
+static int hidemode					= 0;		/* 0 unmaps hidden clients, 1 parks them off-screen (see also M_PARK) */
+static unsigned int parktimeout		= 5000;		/* ms after which parked clients get unmapped on the next arrange, 0 means never */
+static unsigned int focusdwell		= 0;		/* ms the pointer has to rest on a window before it gets focused, 0 focuses right away */
+static unsigned int titlerate		= 10;		/* title updates fetched per second and client, others are coalesced; 0 for no limit */
+static int gamemode					= 1;		/* 1 holds back bar, status, tray and title updates while a fullscreen game is focused */
+static int prewarm					= 0;		/* instances of each of prewarmcmds kept started in the background (at most PREWARMMAX) */
+static int collectstats				= 0;		/* 1 records latencies for moonctl stats, 2 also prints them on exit */
+static unsigned int rtbudget		= 0;		/* round trips to the X server a single event handler may take, 0 means unlimited */
+static int rtstrict					= 0;		/* 1 exits when a handler exceeds its round trip budget (for testing) */
+static int collecttrace				= 0;		/* 1 keeps a trace of recent activity, written on SIGUSR1 or moonctl trace */
+static char tracefile[256]			= "moonwm-trace.json"; /* trace event json, viewable in chrome://tracing or perfetto, relative to $XDG_RUNTIME_DIR or $HOME */
+static char recordfile[256]			= "moonwm-record.bin"; /* event recording for bench/replay, see moonctl record, relative like tracefile */
+/* round trip budgets of single event types, overriding rtbudget if not 0,
+ * set with moonwm.rtbudget.<event> such as moonwm.rtbudget.MotionNotify */
+static unsigned int rtbudgets[LASTEvent];
 static int userules					= 1;		/* 1 means don't apply any rules */
 static int usetagrules				= 0;		/* 1 means don't apply any tag-specific rules */
 static int managekeys = 1;
@@ -167,6 +185,9 @@ static const Layout layouts[] = {
 /* commands */
 static const char *termcmd[]  = { "/bin/sh", "-c", "$TERMINAL", NULL };
 static const char *layoutmenu_cmd = "moonwm-menu layouts-classic";
+/* commands kept started in the background if prewarm is set, spawning one of
+ * them maps the window of a waiting instance instead of starting a new one */
+static const char **prewarmcmds[] = { termcmd };
 
 /* this script or program gets called for bar button presses
  * the button is exported as BUTTON the according module as STATUSCMDN (a number)*/
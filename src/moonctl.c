@@ -2,25 +2,37 @@
 #include <X11/Xatom.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
+#include <X11/Xlib-xcb.h>
+#include <errno.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
 
-#define SIGPREFIX		("fsignal:")
 #define IMPPREFIX		("important:")
-#define SYNCTIME		(10)
 #define DEFTIMEOUT		(100)
+#define REPLYTIMEOUT	(1000)
 #define FCOMMANDHELP	("\t%s\n")
 #define MIN(a,b)		(((a)<(b))?(a):(b))
 #define MAX(a,b)		(((a)>(b))?(a):(b))
+#define LENGTH(X)		(sizeof X / sizeof X[0])
+#define MAXARGS			(8)
+#define PROPLENGTH		(256) /* in 32 bit units */
+
+/* window properties printed by printwindows */
+enum { PropNetName, PropName, PropClass, PropTags, PropMonitor, PropLast };
 
 
 typedef struct {
 	char *symbol, *name, *id;
 } Layout;
 
+typedef struct {
+	char *name, *atom;
+} Event;
+
 static const char *icommands[] = {
 	"borrow",
 	"cyclelayout",
@@ -83,16 +95,21 @@ static const char *lcommands[] = {
 	"-h",
 	"activate",
 	"active",
+	"batch",
 	"borderwidth",
 	"clienttags",
 	"currenttags",
 	"help",
 	"important",
 	"printlayouts",
+	"record",
 	"rootwid",
 	"setlayout",
+	"stats",
 	"status",
 	"togglelayout",
+	"trace",
+	"wait",
 	"windows",
 	"wmname",
 	NULL,
@@ -109,30 +126,52 @@ static const Layout layouts[] = {
 	{  NULL,  NULL,						NULL, },
 };
 
+/* root window properties moonctl wait can wait for */
+static const Event events[] = {
+	{ "active",		"_NET_ACTIVE_WINDOW" },
+	{ "status",		"WM_NAME" },
+	{ "tags",		"_MWM_CURRENT_TAGS" },
+	{ "windows",	"_NET_CLIENT_LIST" },
+	{ NULL,			NULL },
+};
+
 static int screen;
 static char *exename;
 static Display *dpy = NULL;
 static Window root;
+static int json = 0; /* print json instead of text (--json) */
+static int tsv = 0; /* print tab separated values instead of text (--tsv) */
 
 
 static int activate(Window wid, int timeout);
-static void bye();
+static int batch(char *path);
 static void closex();
-static void die(int exitcode, char *message);
+static int fail(int exitcode, char *message);
 static int getproperty(Window wid, Atom atom, unsigned char **prop);
 static int getpropertydetailed (Window wid, Atom atom, Atom *actual_type, int *actual_format,
 		unsigned long *nitems, unsigned long *bytes_after, unsigned char **data);
-static void handlelocal(char *command, int argc, char *argv[]);
+static int handlelocal(char *command, int argc, char *argv[]);
 static void important(char *str);
+static void jsonstr(const char *str);
 static void loadx();
+static long now();
 static void printhelp();
 static void printcmdarr(const char *arr[]);
 static void printlayouts();
-static void printwindow(Window wid);
+static int printreply(char *command, char *arg);
+static void printtags(Window wid, unsigned int tags);
+static void printwindow(Window wid, xcb_get_property_reply_t *props[]);
+static int printwindows(Window *wins, unsigned long n);
+static long propcardinal(xcb_get_property_reply_t *r);
+static char *propstr(xcb_get_property_reply_t *r, char *buf, int size);
+static int runcommand(int argc, char *argv[]);
 static void setlayout(char *arg);
 static void signal(char *commmand, char *type, char *arg);
 static void setstatus(char *str);
+static int splitargs(char *line, char *args[], int max);
 static Window towid(char *str);
+static int waitevent(char *name, int timeout);
+static int waitproperty(Atom atom, long deadline);
 static void wmname(char *name);
 
 
@@ -143,13 +182,18 @@ activate(Window wid, int timeout)
 	XWindowAttributes wattr;
 	Atom atom;
 	unsigned char *result = NULL;
-	int ret, i, status, data;
+	long deadline;
+	int ret, status;
+	Window active;
 
 	if (wid == root) {
 		return 10;
 	}
 
 	atom = XInternAtom(dpy, "_NET_ACTIVE_WINDOW", False);
+	/* select before sending, so the change can not be missed */
+	if (timeout)
+		XSelectInput(dpy, root, PropertyChangeMask);
 
 	xev.type = ClientMessage;
 	xev.xclient.display = dpy;
@@ -165,36 +209,63 @@ activate(Window wid, int timeout)
 
 	if (ret && timeout) {
 		ret = 0;
-		for (i = 0; i < timeout/SYNCTIME; i++) {
+		deadline = now() + timeout;
+		do {
 			status = getproperty(root, atom, &result);
-			if (status == BadWindow) {
-				fprintf(stderr, "window id # 0x%lx does not exists!\n", wid);
-				break;
-				ret = 0;
-			} else if (status != Success) {
+			if (status != Success) {
 				fprintf(stderr, "XGetWindowProperty failed!\n");
-				ret = 13;
-			} else {
-				data = *(int *)result;
-				if (wid == data) {
-					XFree(result);
-					ret = 1;
-					break;
-				}
+				return 0;
 			}
-
-			nanosleep(&((struct timespec) { .tv_nsec = (time_t)(1000000L * (SYNCTIME)) }), NULL);
-		}
+			if (result) {
+				active = *(Window *)result;
+				XFree(result);
+				if (active == wid)
+					return 1;
+			}
+		} while (waitproperty(atom, deadline));
 	}
 
 	return ret;
 }
 
-void
-bye()
+/* run the commands in path (or stdin for "-") over one connection, one per
+ * line, returns the exit code of the last failing one */
+int
+batch(char *path)
 {
-	closex();
-	exit(EXIT_SUCCESS);
+	char line[1024], *args[MAXARGS];
+	int c, n, status, ret = 0, lineno = 0;
+	FILE *f = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+
+	if (!f)
+		return fail(4, "Unable to open batch file");
+	while (fgets(line, sizeof(line), f)) {
+		lineno++;
+		/* without a newline the line ends here, or fgets() split it */
+		if (!strchr(line, '\n') && (c = getc(f)) != EOF && c != '\n') {
+			fprintf(stderr, "%s: line %d: too long\n", exename, lineno);
+			ret = 1;
+			while ((c = getc(f)) != EOF && c != '\n');
+			continue;
+		}
+		if (!(n = splitargs(line, args, LENGTH(args))) || args[0][0] == '#')
+			continue;
+		if (strcmp(args[0], "batch") == 0) {
+			status = fail(1, "batch can not be nested");
+		} else {
+			status = runcommand(n, args);
+			/* output of previous commands first, in case a script waits for it */
+			fflush(stdout);
+		}
+		if (status) {
+			fprintf(stderr, "%s: line %d: '%s' failed\n", exename, lineno, args[0]);
+			ret = status;
+		}
+	}
+	if (f != stdin)
+		fclose(f);
+	XSync(dpy, False);
+	return ret;
 }
 
 void
@@ -205,12 +276,12 @@ closex()
 	dpy = NULL;
 }
 
-void
-die(int exitcode, char *message)
+/* report an error without exiting, for batch mode */
+int
+fail(int exitcode, char *message)
 {
 	fprintf(stderr, "%s\n", message);
-	closex();
-	exit(exitcode);
+	return exitcode;
 }
 
 int
@@ -233,86 +304,112 @@ getpropertydetailed (Window wid, Atom atom, Atom *actual_type, int *actual_forma
 	return status;
 }
 
-void
+int
 handlelocal(char *command, int argc, char *argv[])
 {
-	int wid, timeout, tags, status, bw, i;
+	int timeout, tags, status, bw;
+	Window wid;
 	unsigned char *data = NULL;
 	if (strcmp(command, "activate") == 0) {
 		if (argc == 0)
-			die(2, "Not enough arguments");
-		wid = towid(argv[0]);
+			return fail(2, "Not enough arguments");
+		if (!(wid = towid(argv[0])))
+			return fail(3, "Unable to get window");
 		timeout = argc > 1 ? strtol(argv[1], (char **)NULL, 0) : 0;
 		status = activate(wid, timeout);
 		if (status)
-			bye();
+			return 0;
 		else
-			die(5, "Unable to activate");
+			return fail(5, "Unable to activate");
 	} else if (strcmp(command, "active") == 0) {
 		status = getproperty(root, XInternAtom(dpy, "_NET_ACTIVE_WINDOW", False), &data);
 		if (status == Success && data) {
-			wid = *(int *)data;
+			wid = *(Window *)data;
 			XFree(data);
-			printwindow(wid);
-			bye();
+			printwindows(&wid, 1);
+			if (json)
+				printf("\n");
+			return 0;
 		}
-		die(3, "Unable to get active window");
+		return fail(3, "Unable to get active window");
+	} else if (strcmp(command, "batch") == 0) {
+		return batch(argc > 0 ? argv[0] : "-");
 	} else if (strcmp(command, "borderwidth") == 0) {
 		status = getproperty(root, XInternAtom(dpy, "_MWM_BORDER_WIDTH", False), &data);
 		if (status == Success && data) {
 			bw = *(unsigned int *)data;
 			printf("%d\n", bw);
 			XFree(data);
-			bye();
+			return 0;
 		}
-		die(3, "Unable to get border width");
+		return fail(3, "Unable to get border width");
 	} else if (strcmp(command, "clienttags") == 0) {
 		if (argc == 0)
-			die(2, "Not enough arguments");
-		wid = towid(argv[0]);
+			return fail(2, "Not enough arguments");
+		if (!(wid = towid(argv[0])))
+			return fail(3, "Unable to get window");
 		status = getproperty(wid, XInternAtom(dpy, "_MWM_CLIENT_TAGS", False), &data);
 		if (status == Success && data) {
 			tags = *(int *)data;
-			printf("%d\n", tags);
+			printtags(wid, tags);
 			XFree(data);
-			bye();
+			return 0;
 		}
-		die(3, "Unable to get client tags");
+		return fail(3, "Unable to get client tags");
 	} else if (strcmp(command, "currenttags") == 0) {
 		status = getproperty(root, XInternAtom(dpy, "_MWM_CURRENT_TAGS", False), &data);
 		if (status == Success && data) {
 			tags = *(int *)data;
-			printf("%d\n", tags);
+			printtags(None, tags);
 			XFree(data);
-			bye();
+			return 0;
 		}
-		die(3, "Unable to get current tags");
+		return fail(3, "Unable to get current tags");
 	} else if (strcmp(command, "help") == 0
 			|| strcmp(command, "--help") == 0
 			|| strcmp(command, "-h") == 0) {
 		printhelp();
-		bye();
+		return 0;
 	} else if (strcmp(command, "important") == 0) {
 		if (argc == 0)
-			die(2, "Not enough arguments");
+			return fail(2, "Not enough arguments");
 		important(argv[0]);
-		bye();
+		return 0;
 	} else if (strcmp(command, "printlayouts") == 0) {
 		printlayouts();
-		bye();
+		return 0;
+	} else if (strcmp(command, "record") == 0) {
+		if (argc == 0 || (strcmp(argv[0], "start") != 0 && strcmp(argv[0], "stop") != 0))
+			return fail(2, "Please specify start or stop");
+		if (printreply("record", strcmp(argv[0], "start") == 0 ? "1" : "0"))
+			return 0;
+		return fail(3, "Unable to get a reply from moonwm");
 	} else if (strcmp(command, "rootwid") == 0) {
 		printf("%ld\n", DefaultRootWindow(dpy));
-		bye();
+		return 0;
 	} else if (strcmp(command, "setlayout") == 0) {
 		if (argc == 0)
-			die(2, "Not enough arguments");
+			return fail(2, "Not enough arguments");
 		setlayout(argv[0]);
-		bye();
+		return 0;
+	} else if (strcmp(command, "stats") == 0) {
+		if (printreply("stats", argc > 0 && strcmp(argv[0], "reset") == 0 ? "1" : "0"))
+			return 0;
+		return fail(3, "Unable to get statistics from moonwm");
 	} else if (strcmp(command, "status") == 0) {
 		if (argc == 0)
-			die(2, "Not enough arguments");
+			return fail(2, "Not enough arguments");
 		setstatus(argv[0]);
-		bye();
+		return 0;
+	} else if (strcmp(command, "trace") == 0) {
+		if (printreply("trace", "0"))
+			return 0;
+		return fail(3, "Unable to get a reply from moonwm");
+	} else if (strcmp(command, "wait") == 0) {
+		if (argc == 0)
+			return fail(2, "Not enough arguments");
+		timeout = argc > 1 ? strtol(argv[1], (char **)NULL, 0) : 0;
+		return waitevent(argv[0], timeout);
 	} else if (strcmp(command, "windows") == 0) {
 		Atom actual_type;
 		int actual_format;
@@ -320,22 +417,20 @@ handlelocal(char *command, int argc, char *argv[])
 		status = getpropertydetailed(root, XInternAtom(dpy, "_NET_CLIENT_LIST", False),
 				&actual_type, &actual_format, &nitems, &bytes_after, &data);
 		if (status == Success && data && actual_format == 32) {
-			Window *windows = (Window *) data;
-			for (i = 0; i < nitems; i++) {
-				wid = windows[i];
-				printwindow(wid);
-			}
+			if (json)
+				printf("[");
+			status = printwindows((Window *)data, nitems);
+			if (json)
+				printf("]\n");
 			XFree(data);
-			bye();
+			return status;
 		}
-		die(3, "Unable to list windows");
+		return fail(3, "Unable to list windows");
 	} else if (strcmp(command, "wmname") == 0) {
 		wmname(argc == 0 ? NULL : argv[0]);
-		bye();
-	} else {
-		die(1, "Please use a valid command (see -h)");
+		return 0;
 	}
-
+	return fail(1, "Please use a valid command (see -h)");
 }
 
 void
@@ -348,6 +443,22 @@ important(char *str)
 	setstatus(buf);
 }
 
+/* print str as a json string */
+void
+jsonstr(const char *str)
+{
+	putchar('"');
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\')
+			printf("\\%c", *str);
+		else if ((unsigned char)*str < 0x20)
+			printf("\\u%04x", (unsigned char)*str);
+		else
+			putchar(*str);
+	}
+	putchar('"');
+}
+
 void
 loadx()
 {
@@ -363,6 +474,16 @@ loadx()
 	root = RootWindow(dpy, screen);
 }
 
+/* monotonic time in milliseconds */
+long
+now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
 void
 printhelp()
 {
@@ -385,7 +506,18 @@ printhelp()
 	printf("\n\tactivate takes an X window id as first argument and a timeout (ms) as second one.\n");
 	printf("\tIf no timeout is passed there is no check whether the window got focused.\n");
 	printf("\tclienttags also takes an X window id first argument.\n");
-	printf("\timportant, setlayout, status and wmname take strings.\n\n");
+	printf("\timportant, setlayout, status and wmname take strings.\n");
+	printf("\tstats prints latency statistics of moonwm (see moonwm.stats), 'stats reset' also resets them.\n");
+	printf("\ttrace writes the activity trace of moonwm to its trace file (see moonwm.trace).\n");
+	printf("\trecord start and record stop record the events moonwm handles for bench/replay.\n");
+	printf("\tbatch runs the commands in the given file (or stdin if there is none or it is -),\n");
+	printf("\tone per line, over a single connection. Arguments with spaces can be quoted.\n");
+	printf("\twait blocks until the next change of an event and takes a timeout (ms) as second argument:\n\t");
+	for (int i = 0; events[i].name; i++)
+		printf("%s, ", events[i].name);
+	printf("\n");
+	printf("\n--json before a command prints json for active, clienttags, currenttags and windows,\n");
+	printf("--tsv prints active and windows as id, class, instance, tags, monitor and title separated by tabs.\n\n");
 }
 
 void
@@ -407,38 +539,210 @@ printlayouts()
 		printf("%s %s\t\t%s\n", layouts[i].symbol, layouts[i].name, layouts[i].id);
 }
 
+/* send a signal and print the reply moonwm puts in _MWM_STATS */
+int
+printreply(char *command, char *arg)
+{
+	Atom atom = XInternAtom(dpy, "_MWM_STATS", False);
+	unsigned char *data = NULL;
+	long deadline = now() + REPLYTIMEOUT;
+
+	XSelectInput(dpy, root, PropertyChangeMask);
+	/* drop replies to earlier commands of a batch still in the queue */
+	XSync(dpy, True);
+	signal(command, "i", arg);
+	while (waitproperty(atom, deadline)) {
+		/* skip deletions */
+		if (getproperty(root, atom, &data) != Success || !data)
+			continue;
+		fputs((char *)data, stdout);
+		XFree(data);
+		return 1;
+	}
+	return 0;
+}
+
+/* print a tag mask, for json also as the list of tag numbers */
 void
-printwindow(Window wid)
+printtags(Window wid, unsigned int tags)
 {
-	char *title = NULL;
-	int changed = 1;
-	XClassHint classhints = {0};
-	XFetchName(dpy, wid, (char **) &title);
-	XGetClassHint(dpy, wid, &classhints);
-
-	if (title == NULL) {
-		title = "";
-		changed |= (1 << 1);
+	int i, n = 0;
+
+	if (!json) {
+		printf("%u\n", tags);
+		return;
 	}
-	if (classhints.res_name == NULL) {
-		classhints.res_name = "unknown";
-		changed |= (1 << 2);
+	printf("{");
+	if (wid)
+		printf("\"id\":%lu,", wid);
+	printf("\"tags\":%u,\"list\":[", tags);
+	for (i = 0; i < 32; i++)
+		if (tags & (1u << i))
+			printf("%s%d", n++ ? "," : "", i + 1);
+	printf("]}\n");
+}
+
+/* print a window from the replies for its properties */
+void
+printwindow(Window wid, xcb_get_property_reply_t *props[])
+{
+	char title[PROPLENGTH * 4 + 1], hint[PROPLENGTH * 4 + 2] = {0};
+	char *instance = "unknown", *class = "unknown";
+	long tags = propcardinal(props[PropTags]), mon = propcardinal(props[PropMonitor]);
+	int len, offset;
+
+	if (!propstr(props[PropNetName], title, sizeof(title))
+			&& !propstr(props[PropName], title, sizeof(title)))
+		title[0] = '\0';
+	/* WM_CLASS is the instance followed by the class, both null terminated */
+	if (propstr(props[PropClass], hint, sizeof(hint) - 1)) {
+		instance = hint;
+		len = strlen(hint);
+		if (hint[len + 1])
+			class = &hint[len + 1];
 	}
-	if (classhints.res_class == NULL) {
-		classhints.res_class = "unknown";
-		changed |= (1 << 3);
+
+	if (json) {
+		printf("{\"id\":%lu,\"class\":", wid);
+		jsonstr(class);
+		printf(",\"instance\":");
+		jsonstr(instance);
+		printf(",\"title\":");
+		jsonstr(title);
+		printf(",\"tags\":%ld,\"monitor\":%ld}", tags, mon);
+	} else if (tsv) {
+		for (char *c = title; *c; c++)
+			if (*c == '\t' || *c == '\n')
+				*c = ' ';
+		printf("%lu\t%s\t%s\t%ld\t%ld\t%s\n", wid, class, instance, tags, mon, title);
+	} else {
+		offset = 25 - (strlen(class) + strlen(instance));
+		offset = MAX(offset, 0);
+		printf("%-15ld%s (%s) %-*s %s\n", wid, class, instance, offset, "", title);
 	}
+}
+
+/* print the windows, requesting every property of every window before
+ * collecting the first reply, so it is one round-trip for any number */
+int
+printwindows(Window *wins, unsigned long n)
+{
+	static char *names[PropLast] = {
+		[PropNetName] = "_NET_WM_NAME",
+		[PropName] = "WM_NAME",
+		[PropClass] = "WM_CLASS",
+		[PropTags] = "_MWM_CLIENT_TAGS",
+		[PropMonitor] = "_MWM_CLIENT_MONITOR",
+	};
+	xcb_connection_t *xc = XGetXCBConnection(dpy);
+	xcb_get_property_cookie_t *cookies;
+	xcb_get_property_reply_t *props[PropLast];
+	xcb_generic_error_t *e;
+	Atom atoms[PropLast];
+	unsigned long i;
+	int j;
+
+	if (!n)
+		return 0;
+	if (!(cookies = calloc(n * PropLast, sizeof(*cookies))))
+		return fail(7, "Out of memory");
+	XInternAtoms(dpy, names, PropLast, False, atoms);
+	for (i = 0; i < n; i++)
+		for (j = 0; j < PropLast; j++)
+			cookies[i * PropLast + j] = xcb_get_property(xc, 0, wins[i], atoms[j],
+					XCB_GET_PROPERTY_TYPE_ANY, 0, PROPLENGTH);
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < PropLast; j++) {
+			e = NULL;
+			/* windows can be gone by now, that is just an empty property */
+			props[j] = xcb_get_property_reply(xc, cookies[i * PropLast + j], &e);
+			free(e);
+		}
+		if (json && i)
+			printf(",");
+		printwindow(wins[i], props);
+		for (j = 0; j < PropLast; j++)
+			free(props[j]);
+	}
+	free(cookies);
+	return 0;
+}
+
+/* the first value of a 32 bit property, -1 if there is none */
+long
+propcardinal(xcb_get_property_reply_t *r)
+{
+	if (!r || r->format != 32 || xcb_get_property_value_length(r) < 4)
+		return -1;
+	return *(uint32_t *)xcb_get_property_value(r);
+}
+
+/* copy an 8 bit property into buf as a string, NULL if there is none */
+char *
+propstr(xcb_get_property_reply_t *r, char *buf, int size)
+{
+	int len;
+
+	if (!r || r->format != 8 || (len = xcb_get_property_value_length(r)) <= 0)
+		return NULL;
+	len = MIN(len, size - 1);
+	memcpy(buf, xcb_get_property_value(r), len);
+	buf[len] = '\0';
+	return buf;
+}
+
+/* run a single command, argv[0] being its name, returns an exit code */
+int
+runcommand(int argc, char *argv[])
+{
+	int i;
+
+	/* check int commands */
+	for (i = 0; icommands[i]; i++)
+		if (strcmp(argv[0], icommands[i]) == 0) {
+			if (argc < 2) {
+				fprintf(stderr, "The command '%s' requires an argument of type int.\n", argv[0]);
+				return fail(2, "Not enough arguments");
+			}
+			signal(argv[0], "i", argv[1]);
+			return 0;
+		}
+
+	/* check unsigned int commands */
+	for (i = 0; uicommands[i]; i++)
+		if (strcmp(argv[0], uicommands[i]) == 0) {
+			if (argc < 2) {
+				fprintf(stderr, "The command '%s' requires an argument of type unsigned int.\n", argv[0]);
+				return fail(2, "Not enough arguments");
+			}
+			signal(argv[0], "ui", argv[1]);
+			return 0;
+		}
+
+	/* check float commands */
+	for (i = 0; fcommands[i]; i++)
+		if (strcmp(argv[0], fcommands[i]) == 0) {
+			if (argc < 2) {
+				fprintf(stderr, "The command '%s' requires an argument of type float.\n", argv[0]);
+				return fail(2, "Not enough arguments");
+			}
+			signal(argv[0], "f", argv[1]);
+			return 0;
+		}
+
+	/* check commands without argument */
+	for (i = 0; ncommands[i]; i++)
+		if (strcmp(argv[0], ncommands[i]) == 0) {
+			signal(argv[0], NULL, NULL);
+			return 0;
+		}
+
+	/* check local commands*/
+	for (i = 0; lcommands[i]; i++)
+		if (strcmp(argv[0], lcommands[i]) == 0)
+			return handlelocal(argv[0], argc - 1, &argv[1]);
 
-	int offset = 25 - (strlen(classhints.res_class) + strlen(classhints.res_name));
-	offset = MAX(offset, 0);
-	printf("%-15ld%s (%s) %-*s %s\n", wid, classhints.res_class, classhints.res_name,
-			offset, "", title);
-	if (!(changed & (1 << 1)))
-		XFree(title);
-	if (!(changed & (1 << 2)))
-		XFree(classhints.res_name);
-	if (!(changed & (1 << 3)))
-		XFree(classhints.res_class);
+	return fail(1, "Please use a valid command (see -h)");
 }
 
 void
@@ -455,25 +759,26 @@ setlayout(char *arg)
 	signal("setlayout", "i", arg);
 }
 
+/* append the command to _MWM_COMMAND, where moonwm takes it out again,
+ * so any number of commands can be sent without waiting for moonwm */
 void
 signal(char *command, char *type, char *arg)
 {
-	char buf[100] = {0};
+	char buf[100];
+	int len;
 
-	if (!command)
+	if (!command || (type && !arg))
 		return;
 
-	strcpy(buf, SIGPREFIX);
-	strcat(buf, command);
-	strcat(buf, " ");
-	if (type) {
-		if (!arg)
-			return;
-		strcat(buf, type);
-		strcat(buf, " ");
-		strcat(buf, arg);
-	}
-	setstatus(buf);
+	if (type)
+		len = snprintf(buf, sizeof(buf), "%s %s %s\n", command, type, arg);
+	else
+		len = snprintf(buf, sizeof(buf), "%s\n", command);
+	if (len < 0 || len >= sizeof(buf))
+		return;
+	XChangeProperty(dpy, root, XInternAtom(dpy, "_MWM_COMMAND", False),
+			XInternAtom(dpy, "UTF8_STRING", False), 8, PropModeAppend,
+			(unsigned char *)buf, len);
 }
 
 void
@@ -482,21 +787,94 @@ setstatus(char *str)
 	XStoreName(dpy, root, str);
 }
 
+/* split line into at most max whitespace separated arguments in place,
+ * double quotes group words and \\ escapes the next character */
+int
+splitargs(char *line, char *args[], int max)
+{
+	char *r = line, *w;
+	int n = 0, quoted;
+
+	while (n < max) {
+		while (*r == ' ' || *r == '\t' || *r == '\n' || *r == '\r')
+			r++;
+		if (!*r)
+			break;
+		args[n++] = w = r;
+		for (quoted = 0; *r && (quoted || (*r != ' ' && *r != '\t' && *r != '\n' && *r != '\r')); r++) {
+			if (*r == '"')
+				quoted = !quoted;
+			else if (*r == '\\' && r[1])
+				*w++ = *++r;
+			else
+				*w++ = *r;
+		}
+		if (*r)
+			r++;
+		*w = '\0';
+	}
+	return n;
+}
+
 Window
 towid(char *str)
 {
 	int status;
 	unsigned char *data;
+	Window wid;
 	if (strcmp(str, "active") == 0) {
 		status = getproperty(root, XInternAtom(dpy, "_NET_ACTIVE_WINDOW", False), &data);
-		if (status != Success) {
-			die(3, "Unable to get active window");
-		} else
-			return *(Window *) data;
+		if (status != Success || !data)
+			return None;
+		wid = *(Window *) data;
+		XFree(data);
+		return wid;
 	}
 	return strtol(str, (char **)NULL, 0);
 }
 
+/* wait for the next change of the named event, 0 waits forever */
+int
+waitevent(char *name, int timeout)
+{
+	int i;
+
+	for (i = 0; events[i].name; i++)
+		if (strcmp(name, events[i].name) == 0)
+			break;
+	if (!events[i].name)
+		return fail(2, "Please use a valid event (see -h)");
+	XSelectInput(dpy, root, PropertyChangeMask);
+	/* changes queued before, e.g. by earlier commands of a batch, are not next */
+	XSync(dpy, True);
+	if (waitproperty(XInternAtom(dpy, events[i].atom, False), timeout ? now() + timeout : 0))
+		return 0;
+	return fail(6, "Timed out");
+}
+
+/* block on the connection until atom changes on root, which has to have
+ * PropertyChangeMask selected, or deadline (see now(), 0 for none) passed */
+int
+waitproperty(Atom atom, long deadline)
+{
+	XEvent ev;
+	struct pollfd pfd = { .fd = ConnectionNumber(dpy), .events = POLLIN };
+	long left = -1;
+
+	for (;;) {
+		while (XPending(dpy)) {
+			XNextEvent(dpy, &ev);
+			if (ev.type == PropertyNotify && ev.xproperty.window == root
+					&& ev.xproperty.atom == atom)
+				return 1;
+		}
+		if (deadline && (left = deadline - now()) <= 0)
+			return 0;
+		if (poll(&pfd, 1, (int)left) < 0 && errno != EINTR)
+			return 0;
+	}
+}
+
 void
 wmname(char *name) {
 	int status;
@@ -517,9 +895,15 @@ wmname(char *name) {
 int
 main(int argc, char *argv[])
 {
+	int status;
 
-	int i;
 	exename = argv[0];
+	if (argc > 1 && (strcmp(argv[1], "--json") == 0 || strcmp(argv[1], "--tsv") == 0)) {
+		json = argv[1][2] == 'j';
+		tsv = !json;
+		argv++;
+		argc--;
+	}
 	if (argc == 1) {
 		fprintf(stderr, "Please specify a command.\n");
 		exit(EXIT_FAILURE);
@@ -530,52 +914,7 @@ main(int argc, char *argv[])
 			&& strcmp(argv[1], "-h") != 0)
 		loadx();
 
-	/* check int commands */
-	for (i = 0; icommands[i]; i++)
-		if (strcmp(argv[1], icommands[i]) == 0) {
-			if (argc < 3) {
-				fprintf(stderr, "The command '%s' requires an argument of type int.\n", argv[1]);
-				die(2, "Not enough arguments");
-			}
-			signal(argv[1], "i", argv[2]);
-			bye();
-		}
-
-	/* check unsigned int commands */
-	for (i = 0; uicommands[i]; i++)
-		if (strcmp(argv[1], uicommands[i]) == 0) {
-			if (argc < 3) {
-				fprintf(stderr, "The command '%s' requires an argument of type unsigned int.\n", argv[1]);
-				die(2, "Not enough arguments");
-			}
-			signal(argv[1], "ui", argv[2]);
-			bye();
-		}
-
-	/* check float commands */
-	for (i = 0; fcommands[i]; i++)
-		if (strcmp(argv[1], fcommands[i]) == 0) {
-			if (argc < 3) {
-				fprintf(stderr, "The command '%s' requires an argument of type float.\n", argv[1]);
-				die(2, "Not enough arguments");
-			}
-			signal(argv[1], "f", argv[2]);
-			bye();
-		}
-
-	/* check commands without argument */
-	for (i = 0; ncommands[i]; i++)
-		if (strcmp(argv[1], ncommands[i]) == 0) {
-			signal(argv[1], NULL, NULL);
-			bye();
-		}
-
-	/* check local commands*/
-	for (i = 0; lcommands[i]; i++)
-		if (strcmp(argv[1], lcommands[i]) == 0) {
-			handlelocal(argv[1], argc - 2, &argv[2]);
-			bye();
-		}
-
-	die(1, "Please use a valid command (see -h)");
+	status = runcommand(argc - 1, &argv[1]);
+	closex();
+	return status;
 }
@@ -22,10 +22,16 @@
  *
  * To understand everything else, start reading main().
  */
+#define _GNU_SOURCE /* for POSIX_SPAWN_SETSID in glibc */
 #include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
 #include <locale.h>
+#include <poll.h>
 #include <signal.h>
+#include <spawn.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -44,12 +50,17 @@
 #ifdef XINERAMA
 #include <X11/extensions/Xinerama.h>
 #endif /* XINERAMA */
+#ifdef XINPUT2
+#include <X11/extensions/XInput2.h>
+#endif /* XINPUT2 */
 #include <X11/Xft/Xft.h>
 #include <X11/Xlib-xcb.h>
 #include <xcb/res.h>
 
 #include "common.h"
 #include "drw.h"
+#include "record.h"
+#include "stats.h"
 #include "util.h"
 #include "xwrappers.h"
 
@@ -60,6 +71,12 @@
 #define SAMESIZE(A, B)			(abs((A)->w - (B)->w) < 5 && abs((A)->h - (B)->h < 5))
 #define TAGMASK                 ((1 << LENGTH(tags)) - 1)
 #define TAGSLENGTH              (LENGTH(tags))
+#define PREWARMMAX				4
+#define EVENTBATCH				64 /* events handled in a row before run() looks at signals and helpers */
+#define FNVBASIS				14695981039346656037ULL /* the hash to start hashdata() with */
+/* events of managed windows, leaving them only matters to cancel a focus dwell */
+#define CLIENTMASK				(EnterWindowMask|FocusChangeMask|PropertyChangeMask|StructureNotifyMask \
+								| (focusdwell ? LeaveWindowMask : 0))
 
 /* enums */
 enum { ClkMenu, ClkTagBar, ClkLtSymbol, ClkStatusText, ClkWinTitle,
@@ -90,6 +107,19 @@ struct Monitor {
 	Window barwin;
 	const Layout *lt[2];
 	Pertag *pertag;
+	unsigned long long barsig; /* barsignature() when the bar got drawn last, 0 forces a redraw */
+};
+
+typedef struct Child Child;
+struct Child {
+	pid_t pid;
+	long long start, end;		/* spawn and exit time in microseconds */
+	int status;					/* as reported by waitpid() */
+	int fd;						/* read end of its output or -1 */
+	char out[256];				/* beginning of its output */
+	size_t outlen;
+	void (*exited)(Child *ch);	/* called once it has been reaped and its output read */
+	Child *next;
 };
 
 /* function declarations */
@@ -98,11 +128,15 @@ static void applyrules(Client *c);
 static int applysizehints(Client *c, int *x, int *y, int *w, int *h, int *bw, int interact);
 static void arrange(Monitor *m);
 static void arrangemon(Monitor *m);
+static Child *addchild(pid_t pid);
 static void attach(Client *c);
 static void attachaside(Client *c);
 static void attachstack(Client *c);
+static unsigned long long barsignature(Monitor *m);
 static int fake_signal(void);
+static int buttoncmp(const void *a, const void *b);
 static void buttonpress(XEvent *e);
+static const char *bindingname(const Key *k);
 static void borrow(const Arg *arg);
 static void center(const Arg *arg);
 static void centerclient(Client *c);
@@ -114,6 +148,7 @@ static void closeclient(Client *c);
 static int compareclients(const void *a, const void *b);
 static void configure(Client *c);
 static void configurenotify(XEvent *e);
+static int configloop(Client *c, XConfigureRequestEvent *ev);
 static void configurerequest(XEvent *e);
 static void copyvalidchars(char *text, char *rawtext);
 static Monitor *createmon(void);
@@ -129,29 +164,42 @@ static void drawbar(Monitor *m);
 static void drawbars(void);
 static void dropfullscr(Monitor *m, int n, Client *keep);
 static void enternotify(XEvent *e);
+static void enterwindow(Window w);
 static void expose(XEvent *e);
 static void winview(const Arg *arg);
 static void focus(Client *c);
 static void focusaction(const Arg *arg);
 static void focusdir(const Arg *arg);
+static void flushtitles(void);
 static void focusfloating(const Arg *arg);
 static void focusin(XEvent *e);
 static void focusmon(const Arg *arg);
 static void focusstack(const Arg *arg);
+static void gamemodeflush(void);
+static void genericevent(XEvent *e);
 static void gesture(const Arg *arg);
+static int getpointer(int *x, int *y);
+static unsigned long long hashdata(unsigned long long h, const void *data, size_t len);
 static pid_t getparentprocess(pid_t p);
 static unsigned int getsystraywidth();
 static void grabbuttons(Client *c, int focused);
 static void grabkeys(void);
+static void handlesignals(void);
 static void incnmaster(const Arg *arg);
 static void incheight(const Arg *arg);
 static void incwidth(const Arg *arg);
 static int isdescprocess(pid_t p, pid_t c);
+static int keycmp(const void *a, const void *b);
 static void keypress(XEvent *e);
 static void killclient(const Arg *arg);
 static void layout(const Arg *arg, int togglelayout);
+static unsigned long long layouthash(Monitor *m);
 static void layoutmenu(const Arg *arg);
+static void layoutmenudone(Child *ch);
+static void leavenotify(XEvent *e);
 static void loadclientprops(Client *c);
+static unsigned int lowerbound(const unsigned int *order, unsigned int n, const void *base,
+		size_t size, int (*cmp)(const void *, const void *), const void *key);
 static int loadenv(char *name, char **retval, int *retint, unsigned int *retuint);
 static void loadwmprops(void);
 static void loadxrdb(XrmDatabase db);
@@ -171,12 +219,23 @@ static void initclientpos(Client *c);
 static Client *nextdir(Client *s, int x, int y, int dir, int ignorepit);
 static Client *nexttagged(Client *c);
 static Client *nexttiled(Client *c);
+static int parkclient(Client *c, long long now);
+static int parseslop(const char *s, int *dims);
 static void placemouse(const Arg *arg);
+static void pointerevent(int x, int y);
+static void pointermoved(void);
 static int pointintriangle(float x, float y, float x1, float y1, float x2, float y2, float x3, float y3);
 static void pop(Client *);
+static int prewarmadopt(const Arg *arg);
+static void prewarmexited(Child *ch);
+static void prewarmfill(void);
+static int prewarmhold(Window w);
+static void prewarmremove(Window w);
+static void prewarmstop(void);
 static void propertynotify(XEvent *e);
 static void pushstack(const Arg *arg);
 static void quit(const Arg *arg);
+static void recordevents(const Arg *arg);
 static Client *recttoclient(int x, int y, int w, int h);
 static Monitor *recttomon(int x, int y, int w, int h);
 static void removesystrayicon(Client *i);
@@ -194,19 +253,31 @@ static void restack(Monitor *m);
 static void restart(const Arg *arg);
 static void restore(const Arg *arg);
 static void restoreclient(Client *c);
-static int riodraw(Client *c);
+static int restoregeoms(Monitor *m);
+static void riodraw(Client *c, const Arg *spawnarg);
+static void riodrawn(Child *ch);
 static void rioposition(Client *c, int x, int y, int w, int h);
 static void rioresize(const Arg *arg);
 static void riospawn(const Arg *arg);
 static void riospawnsync(const Arg *arg);
+static void readchild(Child *ch);
+static void reapchildren(void);
 static void run(void);
+static void runcommands(void);
+static void runsignal(const char *str);
 static void runautostart(void);
+static void runtimers(void);
 static void scan(void);
 static void scrollresize(const Arg *arg);
+#ifdef XINPUT2
+static void selectrawmotion(int select);
+#endif /* XINPUT2 */
 static void sendmon(Client *c, Monitor *m, int keeptags);
 static void setdesktopnames(void);
 static void setfocus(Client *c);
 static void setfullscreen(Client *c, int fullscreen);
+static void setgamer(Client *c);
+static void setpointer(int x, int y);
 static void setlayout(const Arg *arg);
 static void setcfact(const Arg *arg);
 static void setmfact(const Arg *arg);
@@ -221,14 +292,24 @@ static void setviewport(void);
 static void seturgent(Client *c, int urg);
 static void shiftview(const Arg *arg);
 static void shiftviewclients(const Arg *arg);
-static void showhide(Client *c);
+static void showhide(Client *stack);
+static void showstats(const Arg *arg);
 static void sigchld(int unused);
+static void sigusr1(int unused);
+static int signalcmp(const void *a, const void *b);
 static void slopcommand(char *str);
+static void sortbindings(void);
+static void sortorder(unsigned int *order, unsigned int n, const void *base,
+		size_t size, int (*cmp)(const void *, const void *));
 static void spawn(const Arg *arg);
 static pid_t spawncmd(const Arg *arg);
+static Child *spawnhelper(const char *cmd, void (*done)(Child *ch));
+static Child *spawnproc(char *const argv[], int out);
 static int stackpos(const Arg *arg);
 static void steal(const Arg *arg);
+static void storegeoms(Monitor *m);
 static Client *swallowingclient(Window w);
+static void systraydirty(void);
 static Monitor *systraytomon(Monitor *m);
 static void tag(const Arg *arg);
 static void tagmon(const Arg *arg);
@@ -250,6 +331,7 @@ static void updateclientlist(void);
 static void updateclientmonitor(Client *c);
 static void updateclienttags(Client *c);
 static void updatecurrenttags(void);
+static void updategamemode(void);
 static int updategeom(void);
 static void updatemotifhints(Client *c);
 static void updatenumlockmask(void);
@@ -267,6 +349,7 @@ static pid_t winpid(Window w);
 static Client *wintoclient(Window w);
 static Monitor *wintomon(Window w);
 static Client *wintosystrayicon(Window w);
+static void writetrace(const Arg *arg);
 static void xrdb(const Arg *arg);
 static void zoom(const Arg *arg);
 
@@ -274,7 +357,9 @@ static void zoom(const Arg *arg);
 /* variables */
 static const char autostartblocksh[] = "autostart_blocking.sh";
 static const char autostartsh[] = "autostart.sh";
-static const char providedautostart[] = "moonwm-utils start";
+/* runs the provided autostart, then the blocking and the non-blocking script
+ * given as $1 and $2 (if not empty) one after another in the background */
+static const char autostartcmd[] = "moonwm-utils start; [ -n \"$1\" ] && \"$1\"; [ -n \"$2\" ] && exec \"$2\"";
 static Systray *systray =  NULL;
 static const char broken[] = "moonwm-utils start";
 static const char moonwmdir[] = "moonwm";
@@ -295,6 +380,20 @@ static int ignorewarp = 0;
 static int istatustimer = 0;
 static int riodimensions[4] = { -1, -1, -1, -1 };
 static pid_t riopid = 0;
+static pid_t riohelperpid = 0; /* slop, while a selection is running */
+static Window riowin = None; /* client to resize once the selection is done */
+static Arg riospawnarg; /* command to spawn once the selection is done */
+static int riospawnpending = 0;
+static pid_t layoutmenupid = 0;
+static Client *gamer = NULL; /* focused fullscreen game, see gamemode */
+static int gamerbypass = 0; /* we set _NET_WM_BYPASS_COMPOSITOR on gamer */
+static int gamedeferred = 0; /* Defer* work held back while gamer is set */
+static long long titledue = 0; /* when the next coalesced title is fetched, 0 if none is */
+static Window dwellwin = None; /* window entered last, focused at dwelldue (see focusdwell) */
+static long long dwelldue = 0;
+static int pointerx, pointery; /* where the pointer is, if pointervalid (see getpointer()) */
+static int pointervalid = 0;
+static int xiopcode = 0; /* XInput2, if its raw motion tells us that the pointer moved */
 static void (*handler[LASTEvent]) (XEvent *) = {
 	[ButtonPress] = buttonpress,
 	[ClientMessage] = clientmessage,
@@ -304,7 +403,9 @@ static void (*handler[LASTEvent]) (XEvent *) = {
 	[EnterNotify] = enternotify,
 	[Expose] = expose,
 	[FocusIn] = focusin,
+	[GenericEvent] = genericevent,
 	[KeyPress] = keypress,
+	[LeaveNotify] = leavenotify,
 	[MappingNotify] = mappingnotify,
 	[MapRequest] = maprequest,
 	[MotionNotify] = motionnotify,
@@ -314,6 +415,9 @@ static void (*handler[LASTEvent]) (XEvent *) = {
 };
 static Atom *atoms;
 static int running = 1;
+static volatile sig_atomic_t dumptrace = 0;
+static int sigpipe[2] = { -1, -1 }; /* signal handlers wake up run() through this */
+static Child *children; /* spawned processes that have not been reaped yet */
 static int restartwm = 0;
 static Cur *cursor[CurLast];
 static Clr **scheme;
@@ -328,17 +432,43 @@ static xcb_connection_t *xcon;
 #include "rules.h"
 #include "config.h"
 
+typedef struct {
+	Client *c;
+	int x, y, w, h, bw;
+} Geom;
+
+typedef struct {
+	const char **cmd;
+	pid_t pid;
+	Window win; /* None until it asked to be mapped */
+} Warm;
+
 struct Pertag {
 	unsigned int curtag, prevtag; /* current and previous tag */
 	int nmasters[LENGTH(tags) + 1]; /* number of windows in master area */
 	float mfacts[LENGTH(tags) + 1]; /* mfacts per tag */
 	unsigned int sellts[LENGTH(tags) + 1]; /* selected layouts */
 	const Layout *ltidxs[LENGTH(tags) + 1][2]; /* matrix of tags and layouts indexes  */
+	unsigned long long geomkeys[LENGTH(tags) + 1]; /* hash of the input of the last layout */
+	Geom *geoms[LENGTH(tags) + 1]; /* tiled client geometries of the last layout */
+	int ngeoms[LENGTH(tags) + 1], geomsizes[LENGTH(tags) + 1];
+	char ltsymbols[LENGTH(tags) + 1][16]; /* layout symbols of the last layout */
 };
 
 /* compile-time check if all tags fit into an unsigned int bit array. */
 struct NumTags { char limitexceeded[LENGTH(tags) > 31 ? -1 : 1]; };
 
+/* binding tables ordered by their lookup key, see sortbindings() */
+static unsigned int keyorder[LENGTH(keys)];
+static unsigned int buttonorder[LENGTH(buttons)];
+static unsigned int signalorder[LENGTH(signals)];
+
+/* the window types of rules and then tagrules, interned in setup() */
+static Atom ruletypes[LENGTH(rules) + LENGTH(tagrules)];
+
+/* instances of prewarmcmds started in the background, see prewarmfill() */
+static Warm pool[LENGTH(prewarmcmds) * PREWARMMAX];
+
 /* function implementations */
 void
 activate(Client *c) {
@@ -360,6 +490,27 @@ activate(Client *c) {
 	}
 }
 
+/* parse the "x%xx%yx%wx%hx" output of slop (see slopcommand()) into dims */
+int
+parseslop(const char *s, int *dims)
+{
+	char *end;
+	long v;
+	int i;
+
+	if (*s++ != 'x')
+		return 0;
+	for (i = 0; i < 4; i++) {
+		errno = 0;
+		v = strtol(s, &end, 10);
+		if (end == s || *end != 'x' || errno || v < INT_MIN || v > INT_MAX)
+			return 0;
+		dims[i] = v;
+		s = end + 1;
+	}
+	return 1;
+}
+
 void
 applyrules(Client *c)
 {
@@ -395,7 +546,7 @@ applyrules(Client *c)
 		&& (!r->class || strstr(class, r->class))
 		&& (!r->role || strstr(role, r->role))
 		&& (!r->instance || strstr(instance, r->instance))
-		&& (!r->wintype || wintype == XInternAtom(dpy, r->wintype, False))
+		&& (!r->wintype || wintype == ruletypes[i])
 		&& (!r->gameid || steamid == r->gameid || (steamid && r->gameid == -1) ))
 		{
 			c->props |= r->props;
@@ -491,6 +642,8 @@ applysizehints(Client *c, int *x, int *y, int *w, int *h, int *bw, int interact)
 void
 arrange(Monitor *m)
 {
+	stats_begin(StatArrange);
+	stats_args(0, m ? m->num : -1);
 	if (m)
 		showhide(m->stack);
 	else for (m = mons; m; m = m->next)
@@ -500,6 +653,7 @@ arrange(Monitor *m)
 		restack(m);
 	} else for (m = mons; m; m = m->next)
 		arrangemon(m);
+	stats_end(StatArrange);
 }
 
 void
@@ -508,15 +662,35 @@ arrangemon(Monitor *m)
 	Client *c;
 	if (sizeof(m->ltsymbol) > strlen(m->lt[m->sellt]->symbol))
 		strcpy(m->ltsymbol, m->lt[m->sellt]->symbol);
-	if (m->lt[m->sellt]->arrange)
-		m->lt[m->sellt]->arrange(m);
-	else
+	if (m->lt[m->sellt]->arrange) {
+		if (!restoregeoms(m)) {
+			stats_begin(StatLayout);
+			stats_args(0, m->num);
+			m->lt[m->sellt]->arrange(m);
+			stats_end(StatLayout);
+			storegeoms(m);
+		}
+	} else
 		/* <>< case; rather than providing an arrange function and upsetting other logic that tests for its presence, simply add borders here */
 		for (c = selmon->clients; c; c = c->next)
 			if (ISVISIBLE(c) && !CMASKGET(c, M_FULLSCREEN) && c->bw == 0)
 				resize(c, c->x, c->y, c->w - 2*borderpx, c->h - 2*borderpx, borderpx, 0);
 }
 
+/* remember a spawned process, so it gets reaped and its exit is known */
+Child *
+addchild(pid_t pid)
+{
+	Child *ch = ecalloc(1, sizeof(Child));
+
+	ch->pid = pid;
+	ch->fd = -1;
+	ch->start = timestamp();
+	ch->next = children;
+	children = ch;
+	return ch;
+}
+
 void
 attach(Client *c)
 {
@@ -565,6 +739,11 @@ swallow(Client *p, Client *c)
 	Window w = p->win;
 	p->win = c->win;
 	c->win = w;
+	int grabs = p->grabs;
+	p->grabs = c->grabs;
+	c->grabs = grabs;
+	CMASKSETTO(p, M_MAPPED, CMASKGET(c, M_MAPPED));
+	CMASKUNSET(c, M_MAPPED);
 	updatetitle(p);
 	XMoveResizeWindow(dpy, p->win, p->x, p->y, p->w, p->h);
 	arrange(p->mon);
@@ -577,6 +756,8 @@ void
 unswallow(Client *c)
 {
 	c->win = c->swallowing->win;
+	c->grabs = c->swallowing->grabs;
+	CMASKUNSET(c, M_MAPPED); /* unmapped in swallow() */
 
 	free(c->swallowing);
 	c->swallowing = NULL;
@@ -589,6 +770,7 @@ unswallow(Client *c)
 		updatetitle(c);
 		arrange(c->mon);
 		XMapWindow(dpy, c->win);
+		CMASKSET(c, M_MAPPED);
 		XMoveResizeWindow(dpy, c->win, c->x, c->y, c->w, c->h);
 		window_set_state(dpy, c->win, NormalState);
 		focus(NULL);
@@ -596,15 +778,62 @@ unswallow(Client *c)
 	}
 }
 
+int
+buttoncmp(const void *a, const void *b)
+{
+	const Button *x = a, *y = b;
+
+	if (x->click != y->click)
+		return x->click < y->click ? -1 : 1;
+	if (x->button != y->button)
+		return x->button < y->button ? -1 : 1;
+	if (CLEANMASK(x->mask) != CLEANMASK(y->mask))
+		return CLEANMASK(x->mask) < CLEANMASK(y->mask) ? -1 : 1;
+	return 0;
+}
+
+/* FNV-1a over everything drawbar() draws for m, so bars whose content did
+ * not change (like on other monitors when focus changes) are not redrawn */
+unsigned long long
+barsignature(Monitor *m)
+{
+	Client *c;
+	unsigned long long h = FNVBASIS;
+	unsigned int occ = 0, seltags = 0;
+	int stw = showsystray && m == systraytomon(m) ? getsystraywidth() : 0;
+	int state[] = { m->wx, m->by, m->ww, bh, stw, m == selmon,
+		m->sel && CMASKGET(m->sel, M_FLOATING) };
+
+	for (c = m->clients; c; c = c->next)
+		occ |= CMASKGET(c, M_BORROWED) ? c->origtags : c->tags;
+	if (m == selmon && m->sel)
+		seltags = CMASKGET(m->sel, M_BORROWED) ? m->sel->origtags : m->sel->tags;
+	h = hashdata(h, state, sizeof(state));
+	/* the colors themselves, xrdb() may hand out new ones at the same address */
+	h = hashdata(h, scheme[SchemeNorm], sizeof(Clr) * LENGTH(colors[0]));
+	h = hashdata(h, scheme[SchemeHigh], sizeof(Clr) * LENGTH(colors[0]));
+	h = hashdata(h, &occ, sizeof(occ));
+	h = hashdata(h, &seltags, sizeof(seltags));
+	h = hashdata(h, &m->tagset[m->seltags], sizeof(m->tagset[m->seltags]));
+	/* strings including their terminator, so they can't run into each other */
+	h = hashdata(h, m->ltsymbol, strlen(m->ltsymbol) + 1);
+	h = hashdata(h, stext, strlen(stext) + 1);
+	if (m->sel)
+		h = hashdata(h, m->sel->name, strlen(m->sel->name) + 1);
+	return h ? h : 1;
+}
+
 void
 buttonpress(XEvent *e)
 {
 	unsigned int i, x, click;
 	Arg arg = {0};
+	const Button *b;
 	Client *c;
 	Monitor *m;
 	XButtonPressedEvent *ev = &e->xbutton;
 	*lastbutton = '0' + ev->button;
+	pointerevent(ev->x_root, ev->y_root);
 
 	click = ClkRootWin;
 	/* focus monitor if necessary */
@@ -655,10 +884,26 @@ buttonpress(XEvent *e)
 		XAllowEvents(dpy, ReplayPointer, CurrentTime);
 		click = ClkClientWin;
 	}
-	for (i = 0; i < LENGTH(buttons); i++)
-		if (click == buttons[i].click && buttons[i].func && buttons[i].button == ev->button
-		&& CLEANMASK(buttons[i].mask) == CLEANMASK(ev->state))
-			buttons[i].func(click == ClkTagBar && buttons[i].arg.i == 0 ? &arg : &buttons[i].arg);
+	const Button probe = { .click = click, .mask = ev->state, .button = ev->button };
+	for (i = lowerbound(buttonorder, LENGTH(buttons), buttons, sizeof(Button), buttoncmp, &probe);
+			i < LENGTH(buttons) && !buttoncmp(&buttons[buttonorder[i]], &probe); i++) {
+		b = &buttons[buttonorder[i]];
+		if (b->func)
+			b->func(click == ClkTagBar && b->arg.i == 0 ? &arg : &b->arg);
+	}
+}
+
+/* name of the function bound to k as moonctl knows it, or its keysym */
+const char *
+bindingname(const Key *k)
+{
+	unsigned int i;
+	const char *name;
+
+	for (i = 0; i < LENGTH(signals); i++)
+		if (signals[i].func == k->func)
+			return signals[i].sig;
+	return (name = XKeysymToString(k->keysym)) ? name : "unknown";
 }
 
 void
@@ -748,6 +993,8 @@ cleanup(void)
 	selmon->lt[selmon->sellt] = &foo;
 	for (m = mons; m; m = m->next)
 		while (m->stack) {
+			if (m->stack->parked)
+				XMoveWindow(dpy, m->stack->win, m->stack->x, m->stack->y);
 			XMapWindow(dpy, m->stack->win);
 			window_set_state(dpy, m->stack->win, NormalState);
 			unmanage(m->stack, 0);
@@ -772,11 +1019,16 @@ cleanup(void)
 	XSync(dpy, False);
 	XSetInputFocus(dpy, PointerRoot, RevertToPointerRoot, CurrentTime);
 	XDeleteProperty(dpy, root, atoms[NetActiveWindow]);
+	if (collectstats > 1)
+		stats_print(stderr);
+	record_stop();
+	prewarmstop();
 }
 
 void
 cleanupmon(Monitor *mon)
 {
+	int i;
 	Monitor *m;
 
 	if (mon == mons)
@@ -787,6 +1039,8 @@ cleanupmon(Monitor *mon)
 	}
 	XUnmapWindow(dpy, mon->barwin);
 	XDestroyWindow(dpy, mon->barwin);
+	for (i = 0; i <= LENGTH(tags); i++)
+		free(mon->pertag->geoms[i]);
 	free(mon->pertag);
 	free(mon);
 }
@@ -823,7 +1077,7 @@ clientmessage(XEvent *e)
 			c->h = c->oldh = wa.height;
 			c->oldbw = wa.border_width;
 			c->bw = 0;
-			CMASKSET(c, M_FLOATING);
+			CMASKSET(c, M_FLOATING|M_TRAYDIRTY);
 			/* reuse tags field as mapped status */
 			c->tags = 1;
 			updatesizehints(c);
@@ -843,8 +1097,8 @@ clientmessage(XEvent *e)
 			/* send_event(dpy, c->win, atoms[Xembed], StructureNotifyMask, CurrentTime, XEMBED_WINDOW_ACTIVATE, 0 , systray->win, XEMBED_EMBEDDED_VERSION); */
 			/* send_event(dpy, c->win, atoms[Xembed], StructureNotifyMask, CurrentTime, XEMBED_MODALITY_ON, 0 , systray->win, XEMBED_EMBEDDED_VERSION); */
 			XSync(dpy, False);
-			resizebarwin(selmon);
 			updatesystray();
+			resizebarwin(selmon);
 			window_set_state(dpy, c->win, NormalState);
 		}
 		return;
@@ -972,6 +1226,26 @@ configurenotify(XEvent *e)
 	}
 }
 
+/* whether c repeated the same configure request more than cfgrepeats times
+ * in a row, each within cfgwindow of the previous one; answering doesn't
+ * change anything for such clients and just keeps them looping */
+int
+configloop(Client *c, XConfigureRequestEvent *ev)
+{
+	long req[] = { ev->value_mask, ev->x, ev->y, ev->width, ev->height,
+		ev->border_width, ev->above, ev->detail };
+	unsigned long long h = hashdata(FNVBASIS, req, sizeof(req));
+	long long t = timestamp();
+
+	if (h == c->cfghash && t - c->cfgtime < cfgwindow * 1000LL)
+		c->cfgrepeats++;
+	else
+		c->cfgrepeats = 0;
+	c->cfghash = h;
+	c->cfgtime = t;
+	return c->cfgrepeats >= cfgrepeats;
+}
+
 void
 configurerequest(XEvent *e)
 {
@@ -1011,8 +1285,12 @@ configurerequest(XEvent *e)
 				configure(c);
 			if (ISVISIBLE(c))
 				XMoveResizeWindow(dpy, c->win, c->x, c->y, c->w, c->h);
+		} else if (configloop(c, ev)) {
+			stats_configure(c->win, 1);
+			return;
 		} else
 			configure(c);
+		stats_configure(c->win, 0);
 	} else {
 		wc.x = ev->x;
 		wc.y = ev->y;
@@ -1023,7 +1301,6 @@ configurerequest(XEvent *e)
 		wc.stack_mode = ev->detail;
 		XConfigureWindow(dpy, ev->window, ev->value_mask, &wc);
 	}
-	XSync(dpy, False);
 }
 
 void
@@ -1100,14 +1377,15 @@ destroynotify(XEvent *e)
 	Client *c;
 	XDestroyWindowEvent *ev = &e->xdestroywindow;
 
+	prewarmremove(ev->window);
 	if ((c = wintoclient(ev->window)))
 		unmanage(c, 1);
 	else if ((c = swallowingclient(ev->window)))
 		unmanage(c->swallowing, 1);
 	else if ((c = wintosystrayicon(ev->window))) {
 		removesystrayicon(c);
-		resizebarwin(selmon);
 		updatesystray();
+		resizebarwin(selmon);
 	}
 }
 
@@ -1231,6 +1509,7 @@ dragcfact(const Arg *arg)
 	ignorewarp = 0;
 
 	XUngrabPointer(dpy, CurrentTime);
+	pointermoved();
 	while (XCheckMaskEvent(dpy, EnterWindowMask, &ev));
 }
 
@@ -1303,6 +1582,7 @@ dragmfact(const Arg *arg)
 	ignorewarp = 0;
 
 	XUngrabPointer(dpy, CurrentTime);
+	pointermoved();
 	while (XCheckMaskEvent(dpy, EnterWindowMask, &ev));
 }
 
@@ -1311,8 +1591,18 @@ drawbar(Monitor *m)
 {
 	int clienttags, x, w, tw = 0, stw = 0;
 	unsigned int i, occ = 0, urg = 0;
+	unsigned long long sig;
 	Client *c;
 
+	if (gamer) {
+		gamedeferred |= DeferBars;
+		return;
+	}
+	if ((sig = barsignature(m)) == m->barsig)
+		return;
+	m->barsig = sig;
+	stats_begin(StatDrawbar);
+	stats_args(m->barwin, m->num);
 	if(showsystray && m == systraytomon(m))
 		stw = getsystraywidth();
 
@@ -1379,6 +1669,7 @@ drawbar(Monitor *m)
 		}
 	}
 	drw_map(drw, m->barwin, 0, 0, m->ww - stw, bh);
+	stats_end(StatDrawbar);
 }
 
 void
@@ -1407,14 +1698,31 @@ dropfullscr(Monitor *m, int n, Client *keep)
 void
 enternotify(XEvent *e)
 {
-	Client *c;
-	Monitor *m;
 	XCrossingEvent *ev = &e->xcrossing;
 
+	pointerevent(ev->x_root, ev->y_root);
 	if ((ev->mode != NotifyNormal || ev->detail == NotifyInferior) && ev->window != root)
 		return;
-	c = wintoclient(ev->window);
-	m = c ? c->mon : wintomon(ev->window);
+	/* windows only crossed on the way to another one are never focused */
+	if (focusdwell && wintoclient(ev->window)) {
+		dwellwin = ev->window;
+		dwelldue = timestamp() + focusdwell * 1000LL;
+		return;
+	}
+	dwellwin = None;
+	dwelldue = 0;
+	enterwindow(ev->window);
+}
+
+/* focus follows the pointer into w */
+void
+enterwindow(Window w)
+{
+	Client *c;
+	Monitor *m;
+
+	c = wintoclient(w);
+	m = c ? c->mon : wintomon(w);
 	if (m != selmon) {
 		unfocus(selmon->sel, 1);
 		selmon = m;
@@ -1423,6 +1731,19 @@ enternotify(XEvent *e)
 	focus(c);
 }
 
+/* leaving the window the pointer rests in for the focus, e.g. onto the bar
+ * or the tray where no client gets entered, cancels the dwell */
+void
+leavenotify(XEvent *e)
+{
+	XCrossingEvent *ev = &e->xcrossing;
+
+	if (ev->window == dwellwin && ev->mode == NotifyNormal && ev->detail != NotifyInferior) {
+		dwellwin = None;
+		dwelldue = 0;
+	}
+}
+
 void
 expose(XEvent *e)
 {
@@ -1430,9 +1751,12 @@ expose(XEvent *e)
 	XExposeEvent *ev = &e->xexpose;
 
 	if (ev->count == 0 && (m = wintomon(ev->window))) {
+		m->barsig = 0;
 		drawbar(m);
-		if (m == selmon)
+		if (m == selmon && showsystray && systray) {
+			systray->dirty = 1;
 			updatesystray();
+		}
 	}
 }
 
@@ -1455,9 +1779,42 @@ winview(const Arg *arg)
 	view(&a);
 }
 
+/* fetch the titles coalesced by propertynotify() whose time has come */
+void
+flushtitles(void)
+{
+	Client *c;
+	Monitor *m;
+	long long t = timestamp(), due;
+
+	titledue = 0;
+	if (gamer) {
+		gamedeferred |= DeferTitles;
+		return;
+	}
+	for (m = mons; m; m = m->next)
+		for (c = m->clients; c; c = c->next) {
+			if (!CMASKGET(c, M_TITLEDIRTY))
+				continue;
+			if (titlerate && (due = c->titletime + 1000000 / titlerate) > t) {
+				titledue = titledue ? MIN(titledue, due) : due;
+				continue;
+			}
+			CMASKUNSET(c, M_TITLEDIRTY);
+			updatetitle(c);
+			if (c == c->mon->sel)
+				drawbar(c->mon);
+		}
+}
+
 void
 focus(Client *c)
 {
+	stats_begin(StatFocus);
+	stats_args(c ? c->win : 0, selmon->num);
+	/* whatever got focused, the pointer resting somewhere doesn't matter */
+	dwellwin = None;
+	dwelldue = 0;
 	if (!c || !ISVISIBLE(c))
 		for (c = selmon->stack; c && !ISVISIBLE(c); c = c->snext);
 	if (selmon->sel && selmon->sel != c)
@@ -1477,7 +1834,9 @@ focus(Client *c)
 		XDeleteProperty(dpy, root, atoms[NetActiveWindow]);
 	}
 	selmon->sel = c;
+	updategamemode();
 	drawbars();
+	stats_end(StatFocus);
 }
 
 void
@@ -1572,8 +1931,10 @@ focusmon(const Arg *arg)
 	focus(NULL);
 	if (selmon->sel)
 		warp(selmon->sel, 0);
-	else
+	else {
 		XWarpPointer(dpy, None, root, 0, 0, 0, 0, selmon->wx + selmon->ww / 2, selmon->wy + selmon->wh / 2);
+		pointermoved();
+	}
 }
 
 void
@@ -1591,6 +1952,63 @@ focusstack(const Arg *arg)
 	restack(selmon);
 }
 
+unsigned long long
+hashdata(unsigned long long h, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+
+	while (len--)
+		h = (h ^ *p++) * 1099511628211ULL;
+	return h;
+}
+
+/* where the pointer is, asking the server only if it could have moved since
+ * the last pointer event */
+int
+getpointer(int *x, int *y)
+{
+	if (!pointervalid) {
+		if (!get_pointer_pos(dpy, root, x, y))
+			return 0;
+		setpointer(*x, *y);
+	}
+	*x = pointerx;
+	*y = pointery;
+	return 1;
+}
+
+/* catch up with the work held back in game mode */
+void
+gamemodeflush(void)
+{
+	Client *c;
+	Monitor *m;
+	int deferred = gamedeferred;
+
+	gamedeferred = 0;
+	if (deferred & DeferTitles)
+		for (m = mons; m; m = m->next)
+			for (c = m->clients; c; c = c->next)
+				if (CMASKGET(c, M_TITLEDIRTY))
+					updatetitle(c);
+	if (deferred & DeferTray)
+		updatesystray();
+	/* the last WM_NAME may as well have been a signal */
+	if (deferred & DeferStatus && !fake_signal())
+		updatestatus();
+	else if (deferred & (DeferBars|DeferTitles))
+		drawbars();
+}
+
+void
+genericevent(XEvent *e)
+{
+#ifdef XINPUT2
+	if (xiopcode && e->xcookie.extension == xiopcode && e->xcookie.evtype == XI_RawMotion)
+		pointermoved();
+#endif /* XINPUT2 */
+}
+
 void
 gesture(const Arg *arg)
 {
@@ -1613,35 +2031,38 @@ gesture(const Arg *arg)
 }
 
 
+/* width of the tray as of the last updatesystray() */
 unsigned int
 getsystraywidth()
 {
-	unsigned int w = 0;
-	Client *i;
-	if(showsystray)
-		for(i = systray->icons; i; w += i->w + systrayspacing, i = i->next) ;
-	return w ? w + systrayspacing : 1;
+	return showsystray && systray && systray->w ? systray->w : 1;
 }
 
 void
 grabbuttons(Client *c, int focused)
 {
-	updatenumlockmask();
-	{
-		unsigned int i, j;
-		unsigned int modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
+	unsigned int i, j;
+	unsigned int modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
+	unsigned int nmodifiers = numlockmask ? LENGTH(modifiers) : 2;
+	int grabs = focused ? GrabFocused : GrabUnfocused;
+
+	if (c->grabs == grabs)
+		return;
+	/* grabbing AnyButton replaces all other grabs on the window,
+	 * so only the switch to focused needs an explicit ungrab */
+	if (!focused)
+		XGrabButton(dpy, AnyButton, AnyModifier, c->win, False,
+			BUTTONMASK, GrabModeSync, GrabModeSync, None, None);
+	else if (c->grabs != GrabNone)
 		XUngrabButton(dpy, AnyButton, AnyModifier, c->win);
-		if (!focused)
-			XGrabButton(dpy, AnyButton, AnyModifier, c->win, False,
-				BUTTONMASK, GrabModeSync, GrabModeSync, None, None);
-		for (i = 0; i < LENGTH(buttons); i++)
-			if (buttons[i].click == ClkClientWin)
-				for (j = 0; j < LENGTH(modifiers); j++)
-					XGrabButton(dpy, buttons[i].button,
-						buttons[i].mask | modifiers[j],
-						c->win, False, BUTTONMASK,
-						GrabModeAsync, GrabModeSync, None, None);
-	}
+	for (i = 0; i < LENGTH(buttons); i++)
+		if (buttons[i].click == ClkClientWin)
+			for (j = 0; j < nmodifiers; j++)
+				XGrabButton(dpy, buttons[i].button,
+					buttons[i].mask | modifiers[j],
+					c->win, False, BUTTONMASK,
+					GrabModeAsync, GrabModeSync, None, None);
+	c->grabs = grabs;
 }
 
 void
@@ -1649,21 +2070,35 @@ grabkeys(void)
 {
 	if (!managekeys)
 		return;
-	updatenumlockmask();
 	{
 		unsigned int i, j;
 		unsigned int modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
+		unsigned int nmodifiers = numlockmask ? LENGTH(modifiers) : 2;
 		KeyCode code;
 
 		XUngrabKey(dpy, AnyKey, AnyModifier, root);
 		for (i = 0; i < LENGTH(keys); i++)
 			if ((code = XKeysymToKeycode(dpy, keys[i].keysym)))
-				for (j = 0; j < LENGTH(modifiers); j++)
+				for (j = 0; j < nmodifiers; j++)
 					XGrabKey(dpy, code, keys[i].mod | modifiers[j], root,
 						True, GrabModeAsync, GrabModeAsync);
 	}
 }
 
+/* act on signals caught since the last call, outside of the signal handlers */
+void
+handlesignals(void)
+{
+	char buf[64];
+
+	while (read(sigpipe[0], buf, sizeof(buf)) > 0);
+	reapchildren();
+	if (dumptrace) {
+		dumptrace = 0;
+		writetrace(&(Arg){0});
+	}
+}
+
 void
 incnmaster(const Arg *arg)
 {
@@ -1728,20 +2163,36 @@ incwidth(const Arg *arg)
 		   selmon->sel->h);
 }
 
+int
+keycmp(const void *a, const void *b)
+{
+	const Key *x = a, *y = b;
+
+	if (x->keysym != y->keysym)
+		return x->keysym < y->keysym ? -1 : 1;
+	if (CLEANMASK(x->mod) != CLEANMASK(y->mod))
+		return CLEANMASK(x->mod) < CLEANMASK(y->mod) ? -1 : 1;
+	return 0;
+}
+
 void
 keypress(XEvent *e)
 {
 	unsigned int i;
-	KeySym keysym;
-	XKeyEvent *ev;
-
-	ev = &e->xkey;
-	keysym = XKeycodeToKeysym(dpy, (KeyCode)ev->keycode, 0);
-	for (i = 0; i < LENGTH(keys); i++)
-		if (keysym == keys[i].keysym
-		&& CLEANMASK(keys[i].mod) == CLEANMASK(ev->state)
-		&& keys[i].func)
-			keys[i].func(&(keys[i].arg));
+	XKeyEvent *ev = &e->xkey;
+	const Key probe = { .mod = ev->state, .keysym = XKeycodeToKeysym(dpy, (KeyCode)ev->keycode, 0) };
+	const Key *k;
+
+	for (i = lowerbound(keyorder, LENGTH(keys), keys, sizeof(Key), keycmp, &probe);
+			i < LENGTH(keys) && !keycmp(&keys[keyorder[i]], &probe); i++) {
+		k = &keys[keyorder[i]];
+		if (k->func) {
+			/* naming the binding takes a search, only do it when measuring */
+			if (stats_enabled())
+				stats_keypress(bindingname(k));
+			k->func(&(k->arg));
+		}
+	}
 }
 
 int
@@ -1749,11 +2200,7 @@ fake_signal(void)
 {
 	char fsignal[256];
 	char indicator[9] = "fsignal:";
-	char str_sig[50];
-	char param[16];
-	int i, len_str_sig, n, paramn;
 	size_t len_fsignal, len_indicator = strlen(indicator);
-	Arg arg;
 
 	// Get root name property
 	if (window_get_textprop(dpy, root, XA_WM_NAME, fsignal, sizeof(fsignal))) {
@@ -1761,23 +2208,7 @@ fake_signal(void)
 
 		// Check if this is indeed a fake signal
 		if (len_indicator > len_fsignal ? 0 : strncmp(indicator, fsignal, len_indicator) == 0) {
-			paramn = sscanf(fsignal+len_indicator, "%s%n%s%n", str_sig, &len_str_sig, param, &n);
-
-			if (paramn == 1) arg = (Arg) {0};
-			else if (paramn > 2) return 1;
-			else if (strncmp(param, "i", n - len_str_sig) == 0)
-				sscanf(fsignal + len_indicator + n, "%i", &(arg.i));
-			else if (strncmp(param, "ui", n - len_str_sig) == 0)
-				sscanf(fsignal + len_indicator + n, "%u", &(arg.ui));
-			else if (strncmp(param, "f", n - len_str_sig) == 0)
-				sscanf(fsignal + len_indicator + n, "%f", &(arg.f));
-			else return 1;
-
-			// Check if a signal was found, and if so handle it
-			for (i = 0; i < LENGTH(signals); i++)
-				if (strcmp(str_sig, signals[i].sig) == 0 && signals[i].func)
-					signals[i].func(&(arg));
-
+			runsignal(fsignal + len_indicator);
 			// A fake signal was sent
 			return 1;
 		}
@@ -1812,21 +2243,55 @@ layout(const Arg *arg, int togglelayout)
 		drawbar(selmon);
 }
 
+/* FNV-1a over everything the layout of the current tag depends on */
+unsigned long long
+layouthash(Monitor *m)
+{
+	Client *c;
+	unsigned long long h = FNVBASIS;
+	int settings[] = { m->wx, m->wy, m->ww, m->wh, m->nmaster, m->gappih, m->gappiv,
+		m->gappoh, m->gappov, enablegaps, smartgaps, borderpx, resizehints, centeronrh };
+
+	h = hashdata(h, settings, sizeof(settings));
+	h = hashdata(h, &m->tagset[m->seltags], sizeof(m->tagset[m->seltags]));
+	h = hashdata(h, &m->lt[m->sellt], sizeof(m->lt[m->sellt]));
+	h = hashdata(h, &m->mfact, sizeof(m->mfact));
+	for (c = nexttiled(m->clients); c; c = nexttiled(c->next)) {
+		int hints[] = { c->basew, c->baseh, c->incw, c->inch, c->maxw, c->maxh,
+			c->minw, c->minh, CMASKGET(c, M_FIXED) };
+
+		h = hashdata(h, &c->win, sizeof(c->win));
+		h = hashdata(h, &c->cfact, sizeof(c->cfact));
+		h = hashdata(h, &c->mina, sizeof(c->mina));
+		h = hashdata(h, &c->maxa, sizeof(c->maxa));
+		h = hashdata(h, hints, sizeof(hints));
+	}
+	return h;
+}
+
 void
 layoutmenu(const Arg *arg) {
-	FILE *p;
-	char c[3], *s;
-	int i;
+	Child *ch;
 
-	if (!(p = popen(layoutmenu_cmd, "r")))
-		 return;
-	s = fgets(c, sizeof(c), p);
-	pclose(p);
+	/* the menu runs in the background, layoutmenudone() applies the choice */
+	if (!layoutmenupid && (ch = spawnhelper(layoutmenu_cmd, layoutmenudone)))
+		layoutmenupid = ch->pid;
+}
 
-	if (!s || *s == '\0' || c == '\0')
-		 return;
+void
+layoutmenudone(Child *ch)
+{
+	char *end;
+	long i;
 
-	i = atoi(c);
+	layoutmenupid = 0;
+	if (!ch->outlen)
+		return;
+	errno = 0;
+	i = strtol(ch->out, &end, 10);
+	if (end == ch->out || (*end != '\0' && *end != '\n') || errno
+			|| i < 0 || i >= LENGTH(layouts) || !layouts[i].symbol)
+		return;
 	setlayout(&((Arg) { .v = &layouts[i] }));
 }
 
@@ -1849,6 +2314,23 @@ loadclientprops(Client *c)
 	}
 }
 
+/* first position in order whose entry does not compare less than key */
+unsigned int
+lowerbound(const unsigned int *order, unsigned int n, const void *base,
+		size_t size, int (*cmp)(const void *, const void *), const void *key)
+{
+	unsigned int lo = 0, hi = n, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (cmp((const char *)base + order[mid] * size, key) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
 /* load variable from environment variable */
 int
 loadenv(char *name, char **retval, int *retint, unsigned int *retuint)
@@ -1924,7 +2406,11 @@ manage(Window w, XWindowAttributes *wa)
 	Client *c, *t = NULL, *term = NULL;
 	Window trans = None;
 	XWindowChanges wc;
+	pid_t pid;
+	int riodesc;
 
+	stats_begin(StatManage);
+	stats_args(w, selmon->num);
 	c = ecalloc(1, sizeof(Client));
 	c->win = w;
 	c->pid = winpid(w);
@@ -1935,6 +2421,7 @@ manage(Window w, XWindowAttributes *wa)
 	c->h = c->oldh = wa->height;
 	c->oldbw = wa->border_width;
 	c->cfact = 1.0;
+	CMASKSETTO(c, M_MAPPED, wa->map_state == IsViewable);
 
 	updatetitle(c);
 	c->mon = selmon;
@@ -1946,10 +2433,11 @@ manage(Window w, XWindowAttributes *wa)
 	}
 	loadclientprops(c);
 
-	if (checkignorewin(c, atoms[NetWMWindowTypeDesktop], -1))
-		return;
-	if (checkignorewin(c, atoms[NetWMWindowTypeDock], 1))
+	if (checkignorewin(c, atoms[NetWMWindowTypeDesktop], -1)
+			|| checkignorewin(c, atoms[NetWMWindowTypeDock], 1)) {
+		stats_end(StatManage);
 		return;
+	}
 
 	c->bw = borderpx;
 	initclientpos(c);
@@ -1968,7 +2456,7 @@ manage(Window w, XWindowAttributes *wa)
 	c->sfy = -1;
 	c->sfw = c->w;
 	c->sfh = c->h;
-	XSelectInput(dpy, w, EnterWindowMask|FocusChangeMask|PropertyChangeMask|StructureNotifyMask);
+	XSelectInput(dpy, w, CLIENTMASK);
 	grabbuttons(c, 0);
 	if (!CMASKGET(c, M_FLOATING))
 		CMASKSETTO(c, M_FLOATING|M_OLDSTATE, trans != None || CMASKGET(c, M_FIXED));
@@ -1988,24 +2476,51 @@ manage(Window w, XWindowAttributes *wa)
 	}
 	c->mon->sel = c;
 
-	if (riopid && (!riodraw_matchpid || isdescprocess(riopid, c->pid))
-			&& riodimensions[3] != -1)
-		rioposition(c, riodimensions[0], riodimensions[1], riodimensions[2], riodimensions[3]);
+	/* the launch may have been a shell that started the client */
+	if (c->pid && stats_launchpending())
+		for (pid = c->pid; pid > 1 && !stats_managed(pid); pid = getparentprocess(pid));
+
+	if (riopid) {
+		riodesc = isdescprocess(riopid, c->pid);
+		if (riodimensions[3] != -1 && (!riodraw_matchpid || riodesc))
+			rioposition(c, riodimensions[0], riodimensions[1], riodimensions[2], riodimensions[3]);
+		/* still selecting, riodrawn() positions it; as anything may be
+		 * mapped meanwhile only take what the command started */
+		else if (riohelperpid && !riowin && riodesc)
+			riowin = c->win;
+	}
 
 	arrange(c->mon);
 	if (term)
 		swallow(term, c);
 	focus(NULL);
+	stats_end(StatManage);
 }
 
 void
 mappingnotify(XEvent *e)
 {
 	XMappingEvent *ev = &e->xmapping;
+	unsigned int prevmask = numlockmask;
+	Client *c;
+	Monitor *m;
 
 	XRefreshKeyboardMapping(ev);
-	if (ev->request == MappingKeyboard)
+	if (ev->request == MappingPointer)
+		return;
+	updatenumlockmask();
+	if (ev->request == MappingKeyboard || numlockmask != prevmask)
 		grabkeys();
+	if (numlockmask == prevmask)
+		return;
+	sortbindings();
+	/* button grabs carry the numlock mask, so redo them from scratch */
+	for (m = mons; m; m = m->next)
+		for (c = m->clients; c; c = c->next) {
+			XUngrabButton(dpy, AnyButton, AnyModifier, c->win);
+			c->grabs = GrabNone;
+			grabbuttons(c, c == selmon->sel);
+		}
 }
 
 void
@@ -2016,8 +2531,9 @@ maprequest(XEvent *e)
 	Client *i;
 	if ((i = wintosystrayicon(ev->window))) {
 		send_event(dpy, i->win, atoms[Xembed], StructureNotifyMask, CurrentTime, XEMBED_WINDOW_ACTIVATE, 0, systray->win, XEMBED_EMBEDDED_VERSION);
-		resizebarwin(selmon);
+		CMASKSET(i, M_TRAYDIRTY);
 		updatesystray();
+		resizebarwin(selmon);
 	}
 
 	if (!XGetWindowAttributes(dpy, ev->window, &wa))
@@ -2026,7 +2542,7 @@ maprequest(XEvent *e)
 		return;
 	if (wa.override_redirect)
 		return;
-	if (!wintoclient(ev->window))
+	if (!wintoclient(ev->window) && !prewarmhold(ev->window))
 		manage(ev->window, &wa);
 }
 
@@ -2037,6 +2553,7 @@ motionnotify(XEvent *e)
 	Monitor *m;
 	XMotionEvent *ev = &e->xmotion;
 
+	pointerevent(ev->x_root, ev->y_root);
 	if (ev->window != root)
 		return;
 	if ((m = recttomon(ev->x_root, ev->y_root, 1, 1)) != mon && mon) {
@@ -2135,7 +2652,7 @@ movemouse(const Arg *arg)
 	if (XGrabPointer(dpy, root, False, MOUSEMASK, GrabModeAsync, GrabModeAsync,
 		None, cursor[CurMove]->cursor, CurrentTime) != GrabSuccess)
 		return;
-	if (!get_pointer_pos(dpy, root, &x, &y))
+	if (!getpointer(&x, &y))
 		return;
 	do {
 		XMaskEvent(dpy, MOUSEMASK|ExposureMask|SubstructureRedirectMask, &ev);
@@ -2169,6 +2686,7 @@ movemouse(const Arg *arg)
 		}
 	} while (ev.type != ButtonRelease);
 	XUngrabPointer(dpy, CurrentTime);
+	pointermoved();
 	if ((m = recttomon(c->x, c->y, c->w, c->h)) != selmon) {
 		sendmon(c, m, arg->i ? 1 : 0);
 		selmon = m;
@@ -2290,7 +2808,7 @@ initclientpos(Client *c)
 		c->y = c->mon->wy + (c->mon->wh - HEIGHT(c)) / 2;
 		centerclient(c);
 	} else {
-		get_pointer_pos(dpy, root, &mousex, &mousey);
+		getpointer(&mousex, &mousey);
 
 		if (mousex < c->mon->mx + c->mon->mw / 3)
 			c->x = mousex - spawnedoffset;
@@ -2400,6 +2918,42 @@ nexttiled(Client *c)
 	return c;
 }
 
+/* keep a hidden client mapped but off-screen, returns 0 if it should be unmapped instead */
+int
+parkclient(Client *c, long long now)
+{
+	if (!hidemode && !CMASKGET(c, M_PARK))
+		return 0;
+	if (!c->parked) {
+		c->parked = now ? now : 1;
+		XMoveWindow(dpy, c->win, WIDTH(c) * -2, c->y);
+		return 1;
+	}
+	return !parktimeout || now - c->parked < (long long)parktimeout * 1000;
+}
+
+/* an event reported the pointer at x, y; if more events are waiting behind
+ * it, it has likely moved on since, so only take it from the last one */
+void
+pointerevent(int x, int y)
+{
+	if (XEventsQueued(dpy, QueuedAfterReading))
+		pointermoved();
+	else
+		setpointer(x, y);
+}
+
+/* the pointer moved or got warped, getpointer() has to ask the server */
+void
+pointermoved(void)
+{
+#ifdef XINPUT2
+	if (xiopcode && pointervalid)
+		selectrawmotion(0);
+#endif /* XINPUT2 */
+	pointervalid = 0;
+}
+
 void
 placemouse(const Arg *arg)
 {
@@ -2439,10 +2993,12 @@ placemouse(const Arg *arg)
 	ocx = wa.x;
 	ocy = wa.y;
 
-	if (placemousemode == 2) // warp cursor to client center
+	if (placemousemode == 2) { // warp cursor to client center
 		XWarpPointer(dpy, None, c->win, 0, 0, 0, 0, WIDTH(c) / 2, HEIGHT(c) / 2);
+		pointermoved();
+	}
 
-	if (!get_pointer_pos(dpy, root, &x, &y)) {
+	if (!getpointer(&x, &y)) {
 		if (wasfullscreen)
 			setfullscreen(c, 1);
 		return;
@@ -2536,6 +3092,7 @@ placemouse(const Arg *arg)
 		}
 	} while (ev.type != ButtonRelease);
 	XUngrabPointer(dpy, CurrentTime);
+	pointermoved();
 	XLowerWindow(dpy, c->win);
 
 	if ((m = recttomon(px, py, 1, 1)) && m != c->mon) {
@@ -2571,7 +3128,6 @@ placemouse(const Arg *arg)
 	dropfullscr(c->mon, 0, c);
 }
 
-
 int
 pointintriangle(float x, float y, float x1, float y1, float x2, float y2, float x3, float y3)
 {
@@ -2592,54 +3148,184 @@ pop(Client *c)
 	arrange(c->mon);
 }
 
-void
-propertynotify(XEvent *e)
+/* manage a waiting instance of the command in arg, returns 0 if there is none */
+int
+prewarmadopt(const Arg *arg)
 {
-	Client *c;
-	Window trans;
-	XPropertyEvent *ev = &e->xproperty;
+	XWindowAttributes wa;
+	Window w;
+	size_t i;
 
-	if ((c = wintosystrayicon(ev->window))) {
-		if (ev->atom == XA_WM_NORMAL_HINTS) {
-			updatesizehints(c);
-			updatesystrayicongeom(c, c->w, c->h);
-		}
-		else
-			updatesystrayiconstate(c, ev);
-		resizebarwin(selmon);
-		updatesystray();
-	}
-	if ((ev->window == root) && (ev->atom == XA_WM_NAME)) {
-		if (!fake_signal())
-			updatestatus();
-	}
-	else if (ev->state == PropertyDelete)
-		return; /* ignore */
-	else if ((c = wintoclient(ev->window))) {
-		switch(ev->atom) {
-		default: break;
-		case XA_WM_TRANSIENT_FOR:
-			if (!CMASKGET(c, M_FLOATING) && (XGetTransientForHint(dpy, c->win, &trans)) &&
-				(CMASKSETTO(c, M_FLOATING, (wintoclient(trans)) != NULL)))
-				arrange(c->mon);
-			break;
-		case XA_WM_NORMAL_HINTS:
-			updatesizehints(c);
-			break;
-		case XA_WM_HINTS:
-			updatewmhints(c);
-			drawbars();
-			break;
-		}
-		if (ev->atom == XA_WM_NAME || ev->atom == atoms[NetWMName]) {
-			updatetitle(c);
-			if (c == c->mon->sel)
-				drawbar(c->mon);
-		}
-		if (ev->atom == atoms[NetWMWindowType])
-			updatewindowtype(c);
-		if (ev->atom == atoms[Motif])
-			updatemotifhints(c);
+	for (i = 0; i < LENGTH(pool); i++) {
+		if (pool[i].cmd != arg->v || !pool[i].win)
+			continue;
+		w = pool[i].win;
+		pool[i] = (Warm){0};
+		prewarmfill();
+		if (!XGetWindowAttributes(dpy, w, &wa) || wintoclient(w))
+			continue;
+		manage(w, &wa);
+		return 1;
+	}
+	return 0;
+}
+
+void
+prewarmexited(Child *ch)
+{
+	size_t i;
+
+	for (i = 0; i < LENGTH(pool); i++)
+		if (pool[i].pid == ch->pid)
+			pool[i] = (Warm){0};
+}
+
+/* start or stop instances of prewarmcmds until there are prewarm of each */
+void
+prewarmfill(void)
+{
+	Child *ch;
+	size_t i, j;
+	int n;
+
+	for (i = 0; i < LENGTH(prewarmcmds); i++) {
+		for (j = 0, n = 0; j < LENGTH(pool); j++) {
+			if (pool[j].cmd != prewarmcmds[i])
+				continue;
+			if (n < MIN(prewarm, PREWARMMAX)) {
+				n++;
+			} else if (pool[j].pid > 0) {
+				/* prewarm was lowered by xrdb() */
+				kill(-pool[j].pid, SIGTERM);
+				pool[j] = (Warm){0};
+			}
+		}
+		for (j = 0; j < LENGTH(pool) && n < MIN(prewarm, PREWARMMAX); j++) {
+			if (pool[j].cmd)
+				continue;
+			if (!(ch = spawnproc((char **)prewarmcmds[i], -1)))
+				break;
+			ch->exited = prewarmexited;
+			pool[j] = (Warm){ prewarmcmds[i], ch->pid, None };
+			n++;
+		}
+	}
+}
+
+/* keep the window unmapped if a started instance asks to map it, the
+ * process it belongs to is found like for swallowing */
+int
+prewarmhold(Window w)
+{
+	pid_t pid;
+	size_t i;
+
+	for (i = 0; i < LENGTH(pool) && (!pool[i].pid || pool[i].win); i++);
+	/* spare the round trip of winpid() while no instance waits for its window */
+	if (i == LENGTH(pool) || !(pid = winpid(w)))
+		return 0;
+	for (; i < LENGTH(pool); i++) {
+		if (pool[i].pid && !pool[i].win && isdescprocess(pool[i].pid, pid)) {
+			pool[i].win = w;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void
+prewarmremove(Window w)
+{
+	size_t i;
+
+	for (i = 0; i < LENGTH(pool); i++)
+		if (w && pool[i].win == w)
+			pool[i] = (Warm){0};
+}
+
+/* the waiting instances would never get mapped without us; spawnproc()
+ * gave each its own session, so whatever it started goes as well */
+void
+prewarmstop(void)
+{
+	size_t i;
+
+	for (i = 0; i < LENGTH(pool); i++)
+		if (pool[i].pid > 0)
+			kill(-pool[i].pid, SIGTERM);
+	memset(pool, 0, sizeof(pool));
+}
+
+void
+propertynotify(XEvent *e)
+{
+	Client *c;
+	Window trans;
+	XPropertyEvent *ev = &e->xproperty;
+	long long due;
+	int coalesced = 0;
+
+	if ((c = wintosystrayicon(ev->window))) {
+		if (ev->atom == XA_WM_NORMAL_HINTS) {
+			updatesizehints(c);
+			updatesystrayicongeom(c, c->w, c->h);
+		}
+		else
+			updatesystrayiconstate(c, ev);
+		updatesystray();
+		resizebarwin(selmon);
+	}
+	if ((ev->window == root) && (ev->atom == XA_WM_NAME)) {
+		/* not even fetched while gaming, gamemodeflush() looks at the last one */
+		if (gamer)
+			gamedeferred |= DeferStatus;
+		else if (!fake_signal())
+			updatestatus();
+	}
+	else if (ev->window == root && ev->atom == atoms[MWMCommand]) {
+		if (ev->state == PropertyNewValue)
+			runcommands();
+	}
+	else if (ev->state == PropertyDelete)
+		return; /* ignore */
+	else if ((c = wintoclient(ev->window))) {
+		switch(ev->atom) {
+		default: break;
+		case XA_WM_TRANSIENT_FOR:
+			if (!CMASKGET(c, M_FLOATING) && (XGetTransientForHint(dpy, c->win, &trans)) &&
+				(CMASKSETTO(c, M_FLOATING, (wintoclient(trans)) != NULL)))
+				arrange(c->mon);
+			break;
+		case XA_WM_NORMAL_HINTS:
+			updatesizehints(c);
+			break;
+		case XA_WM_HINTS:
+			updatewmhints(c);
+			drawbars();
+			break;
+		}
+		if (ev->atom == XA_WM_NAME || ev->atom == atoms[NetWMName]) {
+			if (gamer) {
+				/* fetched when game mode ends */
+				CMASKSET(c, M_TITLEDIRTY);
+				gamedeferred |= DeferTitles;
+				coalesced = 1;
+			} else if (titlerate && (due = c->titletime + 1000000 / titlerate) > timestamp()) {
+				/* fetched by flushtitles() once due, only the latest matters */
+				CMASKSET(c, M_TITLEDIRTY);
+				titledue = titledue ? MIN(titledue, due) : due;
+				coalesced = 1;
+			} else {
+				updatetitle(c);
+				if (c == c->mon->sel)
+					drawbar(c->mon);
+			}
+		}
+		if (ev->atom == atoms[NetWMWindowType])
+			updatewindowtype(c);
+		if (ev->atom == atoms[Motif])
+			updatemotifhints(c);
+		stats_property(c->win, coalesced);
 	}
 }
 
@@ -2672,6 +3358,36 @@ quit(const Arg *arg)
 	running = 0;
 }
 
+/* start (arg->i != 0) or stop recording dispatched events to recordfile */
+void
+recordevents(const Arg *arg)
+{
+	char buf[PATH_MAX + 64], path[PATH_MAX];
+	Client *c;
+	Monitor *m;
+	int n = 0;
+
+	userpath(path, sizeof(path), recordfile);
+	if (arg->i) {
+		for (m = mons; m; m = m->next)
+			for (c = m->clients; c; c = c->next, n++);
+		Window wins[n ? n : 1];
+		for (n = 0, m = mons; m; m = m->next)
+			for (c = m->clients; c; c = c->next)
+				wins[n++] = c->win;
+		if (record_start(dpy, path, wins, n))
+			snprintf(buf, sizeof(buf), "recording to %s\n", path);
+		else
+			snprintf(buf, sizeof(buf), "# unable to record to %s\n", path);
+	} else {
+		snprintf(buf, sizeof(buf), record_active() ? "recorded to %s\n"
+				: "# not recording (recording to %s)\n", path);
+		record_stop();
+	}
+	XChangeProperty(dpy, root, atoms[MWMStats], atoms[Utf8], 8,
+			PropModeReplace, (unsigned char *)buf, strlen(buf));
+}
+
 Client *
 recttoclient(int x, int y, int w, int h)
 {
@@ -2769,9 +3485,12 @@ resizeclient(Client *c, int x, int y, int w, int h, int bw)
 	c->oldw = c->w; c->w = wc.width = w;
 	c->oldh = c->h; c->h = wc.height = h;
 	c->oldbw = c->bw = wc.border_width = bw;
+	c->cfgrepeats = 0; /* answering its next request tells it something new */
 
 	if (CMASKGET(c, M_BEINGMOVED))
 		return;
+	if (c->parked)
+		wc.x = WIDTH(c) * -2;
 
 	XConfigureWindow(dpy, c->win, CWX|CWY|CWWidth|CWHeight|CWBorderWidth, &wc);
 	configure(c);
@@ -2782,6 +3501,7 @@ void
 resizefloating(Client *c, int nx, int ny, int nw, int nh) {
  	resize(c, nx, ny, nw, nh, c->bw, False);
 	XWarpPointer(dpy, None, c->win, 0, 0, 0, 0, c->w / 2, c->h / 2);
+	pointermoved();
 
 	/* XEvent ev; */
 	/* while(XCheckMaskEvent(dpy, EnterWindowMask, &ev)); */
@@ -2836,6 +3556,7 @@ resizemouse(const Arg *arg)
 	} while (ev.type != ButtonRelease);
 	XWarpPointer(dpy, None, c->win, 0, 0, 0, 0, c->w + c->bw - 1, c->h + c->bw - 1);
 	XUngrabPointer(dpy, CurrentTime);
+	pointermoved();
 	while (XCheckMaskEvent(dpy, EnterWindowMask, &ev));
 	if ((m = recttomon(c->x, c->y, c->w, c->h)) != selmon) {
 		sendmon(c, m, 0);
@@ -2876,8 +3597,8 @@ resizerequest(XEvent *e)
 
 	if ((i = wintosystrayicon(ev->window))) {
 		updatesystrayicongeom(i, ev->width, ev->height);
-		resizebarwin(selmon);
 		updatesystray();
+		resizebarwin(selmon);
 	}
 }
 
@@ -2910,9 +3631,13 @@ restack(Monitor *m)
 	XEvent ev;
 	XWindowChanges wc;
 
+	stats_begin(StatRestack);
+	stats_args(0, m->num);
 	drawbar(m);
-	if (!m->sel)
+	if (!m->sel) {
+		stats_end(StatRestack);
 		return;
+	}
 	if (CMASKGET(m->sel, M_FLOATING) || !m->lt[m->sellt]->arrange)
 		XRaiseWindow(dpy, m->sel->win);
 	if (m->lt[m->sellt]->arrange) {
@@ -2931,6 +3656,7 @@ restack(Monitor *m)
 			warp(m->sel, 0);
 		ignorewarp = 0;
 	}
+	stats_end(StatRestack);
 }
 
 void
@@ -2948,6 +3674,32 @@ restore(const Arg *arg)
 	restoreclient(selmon->sel);
 }
 
+/* reapply the geometries of the last layout run if nothing it depends on changed */
+int
+restoregeoms(Monitor *m)
+{
+	Client *c;
+	Geom *g;
+	int i, t = m->pertag->curtag, n = m->pertag->ngeoms[t];
+
+	if (!n || m->pertag->geomkeys[t] != layouthash(m))
+		return 0;
+	for (i = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), i++)
+		if (i >= n || m->pertag->geoms[t][i].c != c || CMASKGET(c, M_BEINGMOVED))
+			return 0;
+	if (i != n)
+		return 0;
+
+	for (i = 0; i < n; i++) {
+		g = &m->pertag->geoms[t][i];
+		c = g->c;
+		if (c->x != g->x || c->y != g->y || c->w != g->w || c->h != g->h || c->bw != g->bw)
+			resizeclient(c, g->x, g->y, g->w, g->h, g->bw);
+	}
+	strcpy(m->ltsymbol, m->pertag->ltsymbols[t]);
+	return 1;
+}
+
 void
 restoreclient(Client *c)
 {
@@ -2962,59 +3714,51 @@ restoreclient(Client *c)
 	arrange(selmon);
 }
 
-// drag out an area using slop and resize the selected window to it.
-int
-riodraw(Client *c)
+/* drag out an area using slop in the background, riodrawn() then resizes c
+ * to it, spawns spawnarg in it or positions the window of riopid in it */
+void
+riodraw(Client *c, const Arg *spawnarg)
 {
-	int i;
-	char str[100] = {0};
-	char strout[100] = {0};
-	char tmpstring[30] = {0};
 	char slopcmd[100] = {0};
-	int firstchar = 0;
-	int counter = 0;
+	Child *ch;
 
+	if (riohelperpid)
+		return;
 	slopcommand(slopcmd);
-	FILE *fp = popen(slopcmd, "r");
-
-	while (fgets(str, 100, fp) != NULL)
-		strcat(strout, str);
-
-	pclose(fp);
-
-	if (strlen(strout) < 6)
-		return 0;
-
-	for (i = 0; i < strlen(strout); i++){
-		if(!firstchar) {
-			if (strout[i] == 'x')
-				firstchar = 1;
-			continue;
-		}
-
-		if (strout[i] != 'x')
-			tmpstring[strlen(tmpstring)] = strout[i];
-		else {
-			riodimensions[counter] = atoi(tmpstring);
-			counter++;
-			memset(tmpstring,0,strlen(tmpstring));
-		}
-	}
+	if (!(ch = spawnhelper(slopcmd, riodrawn)))
+		return;
+	riohelperpid = ch->pid;
+	riodimensions[3] = -1;
+	riowin = c ? c->win : None;
+	if ((riospawnpending = spawnarg != NULL))
+		riospawnarg = *spawnarg;
+}
 
-	/* if (c && c->win) */
-	/* 	map(c, 0); */
+void
+riodrawn(Child *ch)
+{
+	Client *c;
 
-	if (riodimensions[0] <= -40 || riodimensions[1] <= -40 || riodimensions[2] <= 50 || riodimensions[3] <= 50) {
+	riohelperpid = 0;
+	if (!parseslop(ch->out, riodimensions) || riodimensions[0] <= -40 || riodimensions[1] <= -40
+			|| riodimensions[2] <= 50 || riodimensions[3] <= 50) {
 		riodimensions[3] = -1;
-		return 0;
+		riowin = None;
+		riospawnpending = 0;
+		return;
 	}
 
-	if (c) {
-		rioposition(c, riodimensions[0], riodimensions[1], riodimensions[2], riodimensions[3]);
-		return 0;
+	/* a client to resize, or the spawned one got managed while selecting */
+	if (riowin) {
+		if ((c = wintoclient(riowin)))
+			rioposition(c, riodimensions[0], riodimensions[1], riodimensions[2], riodimensions[3]);
+		riowin = None;
+		return;
+	}
+	if (riospawnpending) {
+		riospawnpending = 0;
+		riopid = spawncmd(&riospawnarg);
 	}
-
-	return 1;
 }
 
 void
@@ -3058,7 +3802,7 @@ rioresize(const Arg *arg)
 {
 	Client *c = (arg && arg->v ? (Client*)arg->v : selmon->sel);
 	if (c)
-		riodraw(c);
+		riodraw(c, NULL);
 }
 
 /* spawn a new window and drag out an area using slop to postiion it */
@@ -3067,7 +3811,7 @@ riospawn(const Arg *arg)
 {
 	if (riodraw_spawnasync) {
 		riopid = spawncmd(arg);
-		riodraw(NULL);
+		riodraw(NULL, NULL);
 	} else
 		riospawnsync(arg);
 }
@@ -3075,26 +3819,195 @@ riospawn(const Arg *arg)
 void
 riospawnsync(const Arg *arg)
 {
-	if (riodraw(NULL))
-		riopid = spawncmd(arg);
+	riodraw(NULL, arg);
+}
+
+/* read what is available of the output of ch, the beginning is kept */
+void
+readchild(Child *ch)
+{
+	char buf[256];
+	ssize_t n;
+	size_t len;
+
+	while ((n = read(ch->fd, buf, sizeof(buf))) > 0) {
+		len = MIN((size_t)n, sizeof(ch->out) - 1 - ch->outlen);
+		memcpy(ch->out + ch->outlen, buf, len);
+		ch->outlen += len;
+	}
+	ch->out[ch->outlen] = '\0';
+	if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+		close(ch->fd);
+		ch->fd = -1;
+	}
+}
+
+/* reap exited children, and drop the ones whose output has been read too */
+void
+reapchildren(void)
+{
+	Child *ch, **tc;
+	pid_t pid;
+	int status;
+
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+		for (ch = children; ch && ch->pid != pid; ch = ch->next);
+		if (ch) {
+			ch->end = timestamp();
+			ch->status = status;
+		}
+	}
+	for (tc = &children; (ch = *tc);) {
+		if (!ch->end || ch->fd != -1) {
+			tc = &ch->next;
+			continue;
+		}
+		*tc = ch->next;
+		if (ch->exited)
+			ch->exited(ch);
+		free(ch);
+	}
+}
+
+/* run the commands moonctl appended to _MWM_COMMAND, one per line; taking
+ * them out deletes the property, so none get lost or run twice.  All of it
+ * is read at once, the server only deletes a property read to its end */
+void
+runcommands(void)
+{
+	Atom type;
+	int format;
+	unsigned long n, extra;
+	unsigned char *data = NULL;
+	char *line, *next;
+
+	if (XGetWindowProperty(dpy, root, atoms[MWMCommand], 0, LONG_MAX / 4, True, atoms[Utf8],
+			&type, &format, &n, &extra, &data) != Success || !data)
+		return;
+	/* every command ends in a newline, anything after the last is not one */
+	if (format == 8)
+		for (line = (char *)data; (next = memchr(line, '\n', (char *)data + n - line)); line = next + 1) {
+			*next = '\0';
+			runsignal(line);
+		}
+	XFree(data);
+}
+
+/* run a command of the form "name [i|ui|f value]" */
+void
+runsignal(const char *str)
+{
+	char str_sig[50];
+	char param[16];
+	int len_str_sig, n, paramn;
+	unsigned int i;
+	Arg arg;
+	Signal probe;
+
+	paramn = sscanf(str, "%49s%n%15s%n", str_sig, &len_str_sig, param, &n);
+
+	if (paramn < 1) return;
+	else if (paramn == 1) arg = (Arg) {0};
+	else if (strncmp(param, "i", n - len_str_sig) == 0)
+		sscanf(str + n, "%i", &(arg.i));
+	else if (strncmp(param, "ui", n - len_str_sig) == 0)
+		sscanf(str + n, "%u", &(arg.ui));
+	else if (strncmp(param, "f", n - len_str_sig) == 0)
+		sscanf(str + n, "%f", &(arg.f));
+	else return;
+
+	// Check if a signal was found, and if so handle it
+	probe.sig = str_sig;
+	for (i = lowerbound(signalorder, LENGTH(signals), signals, sizeof(Signal), signalcmp, &probe);
+			i < LENGTH(signals) && !signalcmp(&signals[signalorder[i]], &probe); i++)
+		if (signals[signalorder[i]].func)
+			signals[signalorder[i]].func(&(arg));
 }
 
 void
 run(void)
 {
 	XEvent ev;
+	Child *ch;
+	int i, n, pending, batch = 0;
+	long long due;
+
 	/* main event loop */
 	XSync(dpy, False);
-	while (running && !XNextEvent(dpy, &ev))
-		if (handler[ev.type])
+	while (running) {
+		runtimers();
+		/* XPending() flushes, so all requests are out before we sleep */
+		pending = XPending(dpy);
+		/* besides X and signals wait for the output of helpers; while events
+		 * keep coming look at those every EVENTBATCH events, so children are
+		 * still reaped without a syscall for every event */
+		if (!pending || ++batch >= EVENTBATCH) {
+			batch = 0;
+			for (n = 2, ch = children; ch; ch = ch->next)
+				n += ch->fd != -1;
+			struct pollfd fds[n];
+			fds[0] = (struct pollfd){ .fd = ConnectionNumber(dpy), .events = POLLIN };
+			fds[1] = (struct pollfd){ .fd = sigpipe[0], .events = POLLIN };
+			for (i = 2, ch = children; ch; ch = ch->next)
+				if (ch->fd != -1)
+					fds[i++] = (struct pollfd){ .fd = ch->fd, .events = POLLIN };
+			/* wake up for the next timer, rounding up to not spin */
+			if ((due = titledue) == 0 || (dwelldue && dwelldue < due))
+				due = dwelldue;
+			if (poll(fds, n, pending ? 0 : due ? (int)MAX(0, (due - timestamp() + 999) / 1000) : -1) < 0
+					&& errno != EINTR)
+				die("poll:");
+			for (i = 2, ch = children; ch; ch = ch->next)
+				if (ch->fd != -1 && fds[i++].revents)
+					readchild(ch);
+			if (fds[1].revents & POLLIN || (!pending && n > 2))
+				handlesignals();
+			if (!pending)
+				continue;
+		}
+		XNextEvent(dpy, &ev);
+		/* without raw motion the pointer could have moved since any event */
+		if (!xiopcode)
+			pointervalid = 0;
+		if (handler[ev.type]) {
+			if (record_active())
+				record_event(&ev);
+			stats_begin(ev.type);
+			stats_args(ev.xany.window, -1);
 			handler[ev.type](&ev); /* call handler */
+			stats_end(ev.type);
+			/* once everything a key binding caused is handled wait for the
+			 * server to process it, which includes configures and drawing */
+			if (stats_keypending() && !XPending(dpy)) {
+				XSync(dpy, False);
+				stats_keydone();
+			}
+		}
+	}
+}
+
+/* run what is due of the work run() waits for besides events */
+void
+runtimers(void)
+{
+	long long t;
+
+	if (!titledue && !dwelldue)
+		return;
+	t = timestamp();
+	if (titledue && t >= titledue)
+		flushtitles();
+	if (dwelldue && t >= dwelldue) {
+		dwelldue = 0;
+		enterwindow(dwellwin);
+	}
 }
 
 void
 runautostart(void)
 {
 	char *pathpfx;
-	char *path;
+	char *path, *blockpath;
 	char *xdgdatahome;
 	char *home;
 	struct stat sb;
@@ -3103,8 +4016,6 @@ runautostart(void)
 		/* this is almost impossible */
 		return;
 
-	system(providedautostart);
-
 	/* run statuscmd if available */
 	/* @TODO review if it should be removed */
 	if (getenv("MOONWM_LAUNCH_STATUS"))
@@ -3149,26 +4060,17 @@ runautostart(void)
 		}
 	}
 
-	/* try the blocking script first */
-	path = ecalloc(1, strlen(pathpfx) + strlen(autostartblocksh) + 2);
-	if (sprintf(path, "%s/%s", pathpfx, autostartblocksh) <= 0) {
-		free(path);
-		free(pathpfx);
-	}
-
-	if (access(path, X_OK) == 0)
-		system(path);
-
-	/* now the non-blocking script */
-	if (sprintf(path, "%s/%s", pathpfx, autostartsh) <= 0) {
-		free(path);
-		free(pathpfx);
-	}
-
-	if (access(path, X_OK) == 0)
-		system(strcat(path, " &"));
+	/* the blocking script only blocks the non-blocking one, not the event loop */
+	blockpath = ecalloc(1, strlen(pathpfx) + strlen(autostartblocksh) + 2);
+	sprintf(blockpath, "%s/%s", pathpfx, autostartblocksh);
+	path = ecalloc(1, strlen(pathpfx) + strlen(autostartsh) + 2);
+	sprintf(path, "%s/%s", pathpfx, autostartsh);
+	spawnproc((char *[]){ "/bin/sh", "-c", (char *)autostartcmd, "moonwm-autostart",
+			access(blockpath, X_OK) == 0 ? blockpath : "",
+			access(path, X_OK) == 0 ? path : "", NULL }, -1);
 
 	free(pathpfx);
+	free(blockpath);
 	free(path);
 }
 
@@ -3222,6 +4124,19 @@ scrollresize(const Arg *arg)
 	}
 }
 
+#ifdef XINPUT2
+void
+selectrawmotion(int select)
+{
+	unsigned char bits[XIMaskLen(XI_LASTEVENT)] = {0};
+	XIEventMask mask = { XIAllMasterDevices, sizeof(bits), bits };
+
+	if (select)
+		XISetMask(bits, XI_RawMotion);
+	XISelectEvents(dpy, root, &mask, 1);
+}
+#endif /* XINPUT2 */
+
 void
 sendmon(Client *c, Monitor *m, int keeptags)
 {
@@ -3279,6 +4194,7 @@ setfullscreen(Client *c, int fullscreen)
 		resizeclient(c, c->mon->mx, c->mon->my, c->mon->mw, c->mon->mh, 0);
 		c->oldbw = bw;
 		XRaiseWindow(dpy, c->win);
+		updategamemode();
 	} else if (!fullscreen && CMASKGET(c, M_FULLSCREEN)){
 		XChangeProperty(dpy, c->win, atoms[NetWMState], XA_ATOM, 32,
 			PropModeReplace, (unsigned char*)0, 0);
@@ -3290,10 +4206,49 @@ setfullscreen(Client *c, int fullscreen)
 		c->w = c->oldw;
 		c->h = c->oldh;
 		resizeclient(c, c->x, c->y, c->w, c->h, c->bw);
+		updategamemode();
 		arrange(c->mon);
 	}
 }
 
+/* make c the client game mode is active for, NULL ends game mode; lets
+ * compositors unredirect it unless it asked for something itself */
+void
+setgamer(Client *c)
+{
+	long bypass = 1;
+
+	if (c == gamer)
+		return;
+	if (gamer && gamerbypass)
+		XDeleteProperty(dpy, gamer->win, atoms[NetWMBypassCompositor]);
+	gamerbypass = 0;
+	if ((gamer = c)) {
+		if (!window_get_intprop(dpy, c->win, atoms[NetWMBypassCompositor])) {
+			XChangeProperty(dpy, c->win, atoms[NetWMBypassCompositor], XA_CARDINAL, 32,
+					PropModeReplace, (unsigned char *)&bypass, 1);
+			gamerbypass = 1;
+		}
+	} else
+		gamemodeflush();
+}
+
+/* the pointer is at x, y; this stays valid until XInput2 reports motion,
+ * without it only until the next event */
+void
+setpointer(int x, int y)
+{
+#ifdef XINPUT2
+	/* raw motion is only selected while the position is valid, so only the
+	 * first motion afterwards wakes us up */
+	if (xiopcode && !pointervalid)
+		selectrawmotion(1);
+#endif /* XINPUT2 */
+	pointerx = x;
+	pointery = y;
+	pointervalid = 1;
+}
+
 void
 setlayout(const Arg *arg)
 {
@@ -3384,6 +4339,7 @@ setswallow(const Arg *arg)
 
 void
 settings(void) {
+	int i;
 	Display *xrmdisplay;
 	XrmDatabase dpydb, cfiledb;
 	char  *home, *xdgconfighome, *path = NULL;
@@ -3442,6 +4398,10 @@ settings(void) {
 		framerate = 60;
 	if (borderpx > 100)
 		borderpx = 2;
+	for (i = 0; i < LASTEvent; i++)
+		stats_setbudget(i, rtbudgets[i] ? rtbudgets[i] : rtbudget);
+	stats_enable(collectstats, rtstrict);
+	stats_trace(collecttrace);
 	setmodkey("Alt");
 
 	if (imfact >= 5 && imfact <= 95)
@@ -3455,36 +4415,57 @@ settingsenv(void) {
 
 void
 settingsxrdb(XrmDatabase db) {
-	char *modstr = {0};
+	char *modstr = {0}, *str, key[64];
+	int i;
 
 	xrdb_get(db,	"moonwm.modkey",		&modstr, NULL,				NULL);
+	if (xrdb_get(db, "moonwm.tracefile",	&str,	NULL,				NULL))
+		snprintf(tracefile, sizeof(tracefile), "%s", str);
+	if (xrdb_get(db, "moonwm.recordfile",	&str,	NULL,				NULL))
+		snprintf(recordfile, sizeof(recordfile), "%s", str);
 	xrdb_get(db,	"moonwm.centerfloat",	NULL,	&centerspawned,		NULL);
 	xrdb_get(db,	"moonwm.centeronrh",	NULL,	&centeronrh,		NULL);
 	xrdb_get(db,	"moonwm.decorhints",	NULL,	&decorhints,		NULL);
 	xrdb_get(db,	"moonwm.focusdir",		NULL,	&usefocusdir,		NULL);
 	xrdb_get(db,	"moonwm.gaps",			NULL,	&enablegaps,		NULL);
+	xrdb_get(db,	"moonwm.gamemode",		NULL,	&gamemode,			NULL);
+	xrdb_get(db,	"moonwm.hidemode",		NULL,	&hidemode,			NULL);
+	xrdb_get(db,	"moonwm.prewarm",		NULL,	&prewarm,			NULL);
 	xrdb_get(db,	"moonwm.keys",			NULL,	&managekeys,		NULL);
 	xrdb_get(db,	"moonwm.movedir",		NULL,	&usemovedir,		NULL);
+	xrdb_get(db,	"moonwm.rtstrict",		NULL,	&rtstrict,			NULL);
 	xrdb_get(db,	"moonwm.resizehints",	NULL,	&resizehints,		NULL);
 	xrdb_get(db,	"moonwm.rules",			NULL,	&userules,			NULL);
 	xrdb_get(db,	"moonwm.showbar",		NULL,	&showbar,			NULL);
+	xrdb_get(db,	"moonwm.stats",			NULL,	&collectstats,		NULL);
 	xrdb_get(db,	"moonwm.smartgaps",		NULL,	&smartgaps,			NULL);
 	xrdb_get(db,	"moonwm.swallow",		NULL,	&swallowdefault,	NULL);
 	xrdb_get(db,	"moonwm.swallowfloating", NULL,	&swallowfloating,	NULL);
 	xrdb_get(db,	"moonwm.closeswallowed", NULL,	&closeswallowed,	NULL);
 	xrdb_get(db,	"moonwm.systray",		NULL,	&showsystray,		NULL);
 	xrdb_get(db,	"moonwm.tagrules",		NULL,	&usetagrules,		NULL);
+	xrdb_get(db,	"moonwm.trace",			NULL,	&collecttrace,		NULL);
 	xrdb_get(db,	"moonwm.topbar",		NULL,	&topbar,			NULL);
 	xrdb_get(db,	"moonwm.workspaces",	NULL,	&workspaces,		NULL);
 	xrdb_get(db,	"moonwm.wraparound",	NULL,	&wraparound,		NULL);
 	xrdb_get(db,	"moonwm.borderwidth",	NULL,	NULL,	&borderpx);
 	xrdb_get(db,	"moonwm.framerate",		NULL,	NULL,	&framerate);
+	xrdb_get(db,	"moonwm.titlerate",		NULL,	NULL,	&titlerate);
+	xrdb_get(db,	"moonwm.focusdwell",	NULL,	NULL,	&focusdwell);
 	xrdb_get(db,	"moonwm.gaps",			NULL,	NULL,	&gappih);
 	xrdb_get(db,	"moonwm.gaps",			NULL,	NULL,	&gappiv);
 	xrdb_get(db,	"moonwm.gaps",			NULL,	NULL,	&gappoh);
 	xrdb_get(db,	"moonwm.gaps",			NULL,	NULL,	&gappov);
 	xrdb_get(db,	"moonwm.layout",		NULL,	NULL,	&defaultlayout);
 	xrdb_get(db,	"moonwm.mfact",			NULL,	NULL,	&imfact);
+	xrdb_get(db,	"moonwm.parktimeout",	NULL,	NULL,	&parktimeout);
+	xrdb_get(db,	"moonwm.rtbudget",		NULL,	NULL,	&rtbudget);
+	for (i = 0; i < LASTEvent; i++) {
+		if (!stats_name(i))
+			continue;
+		snprintf(key, sizeof(key), "moonwm.rtbudget.%s", stats_name(i));
+		xrdb_get(db, key, NULL, NULL, &rtbudgets[i]);
+	}
 	xrdb_get(db,	"moonwm.inset-top",		NULL,	NULL,	&inset_top);
 	xrdb_get(db,	"moonwm.inset-right",	NULL,	NULL,	&inset_right);
 	xrdb_get(db,	"moonwm.inset-bottom",	NULL,	NULL,	&inset_bottom);
@@ -3497,10 +4478,29 @@ void
 setup(void)
 {
 	int i;
+	const Rule *r;
 	XSetWindowAttributes wa;
-
+	struct sigaction sa = { .sa_flags = SA_RESTART };
+
+	/* signal handlers only wake up the event loop through a pipe */
+	if (pipe(sigpipe) < 0)
+		die("pipe:");
+	for (i = 0; i < 2; i++) {
+		fcntl(sigpipe[i], F_SETFL, fcntl(sigpipe[i], F_GETFL) | O_NONBLOCK);
+		fcntl(sigpipe[i], F_SETFD, FD_CLOEXEC);
+	}
+	sigemptyset(&sa.sa_mask);
+	sa.sa_handler = sigusr1;
+	if (sigaction(SIGUSR1, &sa, NULL) < 0)
+		die("can't install SIGUSR1 handler:");
+	sa.sa_handler = sigchld;
+	sa.sa_flags |= SA_NOCLDSTOP;
+	if (sigaction(SIGCHLD, &sa, NULL) < 0)
+		die("can't install SIGCHLD handler:");
 	/* clean up any zombies immediately */
-	sigchld(0);
+	reapchildren();
+	/* keep spawned processes from inheriting the X connection */
+	fcntl(ConnectionNumber(dpy), F_SETFD, FD_CLOEXEC);
 
 	/* init screen */
 	screen = DefaultScreen(dpy);
@@ -3515,6 +4515,11 @@ setup(void)
 	updategeom();
 	/* init atoms */
 	atoms = get_atoms(dpy);
+	for (i = 0; i < LENGTH(rules) + LENGTH(tagrules); i++) {
+		r = i < LENGTH(rules) ? &rules[i] : &tagrules[i - LENGTH(rules)];
+		if (r->wintype)
+			ruletypes[i] = XInternAtom(dpy, r->wintype, False);
+	}
 	/* init cursors */
 	cursor[CurNormal] = drw_cur_create(drw, XC_left_ptr);
 	cursor[CurResize] = drw_cur_create(drw, XC_sizing);
@@ -3556,6 +4561,16 @@ setup(void)
 		|LeaveWindowMask|StructureNotifyMask|PropertyChangeMask;
 	XChangeWindowAttributes(dpy, root, CWEventMask|CWCursor, &wa);
 	XSelectInput(dpy, root, wa.event_mask);
+#ifdef XINPUT2
+	int xievent, xierror, ximajor = 2, ximinor = 1;
+	/* raw motion is delivered during grabs only since 2.1 */
+	if (!XQueryExtension(dpy, "XInputExtension", &xiopcode, &xievent, &xierror)
+			|| XIQueryVersion(dpy, &ximajor, &ximinor) != Success
+			|| (ximajor == 2 && ximinor < 1))
+		xiopcode = 0;
+#endif /* XINPUT2 */
+	updatenumlockmask();
+	sortbindings();
 	grabkeys();
 	focus(NULL);
 }
@@ -3634,27 +4649,85 @@ shiftviewclients(const Arg *arg)
 }
 
 void
-showhide(Client *c)
+showhide(Client *stack)
 {
-	if (!c)
-		return;
-	if (ISVISIBLE(c)) {
-		/* show clients top down */
+	Client *c;
+	int n = 0;
+	long long now = timestamp();
+
+	/* show clients top down */
+	for (c = stack; c; c = c->snext) {
+		if (!ISVISIBLE(c)) {
+			n += CMASKGET(c, M_MAPPED) && !parkclient(c, now) ? 1 : 0;
+			continue;
+		} else if (c->parked) {
+			c->parked = 0;
+			XMoveWindow(dpy, c->win, c->x, c->y);
+			continue;
+		} else if (CMASKGET(c, M_MAPPED)) {
+			continue;
+		}
 		window_map(dpy, c->win, 1);
-		showhide(c->snext);
-	} else {
-		/* hide clients bottom up */
-		showhide(c->snext);
-		window_unmap(dpy, c->win, root, 1);
+		CMASKSET(c, M_MAPPED);
 	}
+	if (!n)
+		return;
+
+	/* hide clients bottom up */
+	Client *hide[n];
+	for (n = 0, c = stack; c; c = c->snext)
+		if (!ISVISIBLE(c) && CMASKGET(c, M_MAPPED) && !parkclient(c, now))
+			hide[n++] = c;
+	while (n--) {
+		if (hide[n]->parked) {
+			/* move it back while it is unmapped */
+			hide[n]->parked = 0;
+			XMoveWindow(dpy, hide[n]->win, hide[n]->x, hide[n]->y);
+		}
+		window_unmap(dpy, hide[n]->win, root, 1);
+		CMASKUNSET(hide[n], M_MAPPED);
+	}
+}
+
+/* publish the statistics on the root window for moonctl, arg->i resets them afterwards */
+void
+showstats(const Arg *arg)
+{
+	char buf[STATSBUFSIZE];
+	size_t len;
+
+	len = stats_format(buf, sizeof(buf));
+	XChangeProperty(dpy, root, atoms[MWMStats], atoms[Utf8], 8,
+			PropModeReplace, (unsigned char *)buf, len);
+	if (arg->i)
+		stats_reset();
 }
 
 void
 sigchld(int unused)
 {
-	if (signal(SIGCHLD, sigchld) == SIG_ERR)
-		die("can't install SIGCHLD handler:");
-	while (0 < waitpid(-1, NULL, WNOHANG));
+	int err = errno;
+
+	/* children are reaped by handlesignals(), as the child table and the
+	 * callbacks of helpers may only be touched from the main loop */
+	if (write(sigpipe[1], "c", 1) < 0) {}
+	errno = err;
+}
+
+void
+sigusr1(int unused)
+{
+	int err = errno;
+
+	dumptrace = 1;
+	if (write(sigpipe[1], "u", 1) < 0) {}
+	errno = err;
+}
+
+int
+signalcmp(const void *a, const void *b)
+{
+	return strcmp(((const Signal *)a)->sig, ((const Signal *)b)->sig);
 }
 
 void
@@ -3671,15 +4744,41 @@ slopcommand(char *str)
 	strcat(str, sloptheming);
 }
 
+/* key masks depend on numlockmask, so this has to be redone when it changes */
+void
+sortbindings(void)
+{
+	sortorder(keyorder, LENGTH(keys), keys, sizeof(Key), keycmp);
+	sortorder(buttonorder, LENGTH(buttons), buttons, sizeof(Button), buttoncmp);
+	sortorder(signalorder, LENGTH(signals), signals, sizeof(Signal), signalcmp);
+}
+
+/* stable, so equal bindings still fire in the order they are configured */
+void
+sortorder(unsigned int *order, unsigned int n, const void *base,
+		size_t size, int (*cmp)(const void *, const void *))
+{
+	unsigned int i, j;
+
+	for (i = 0; i < n; i++) {
+		for (j = i; j > 0 && cmp((const char *)base + order[j - 1] * size,
+					(const char *)base + i * size) > 0; j--)
+			order[j] = order[j - 1];
+		order[j] = i;
+	}
+}
+
 void
 spawn(const Arg *arg)
 {
-	spawncmd(arg);
+	if (!prewarmadopt(arg))
+		spawncmd(arg);
 }
 
 pid_t
 spawncmd(const Arg *arg)
 {
+	Child *ch;
 	pid_t pid;
 	int now = time(NULL);
 	if (arg->v == statushandler) {
@@ -3690,22 +4789,77 @@ spawncmd(const Arg *arg)
 		setenv("BUTTON", lastbutton, 1);
 		setenv("STATUSCMDN", strstatuscmdn, 1);
 	}
-	if ((pid = fork()) == 0) {
-		if (dpy)
-			close(ConnectionNumber(dpy));
-		setsid();
-		execvp(((char **)arg->v)[0], (char **)arg->v);
-		fprintf(stderr, "moonwm: execvp %s", ((char **)arg->v)[0]);
-		perror(" failed");
-		exit(EXIT_SUCCESS);
-	}
+	stats_begin(StatSpawn);
+	stats_args(0, selmon->num);
+	pid = (ch = spawnproc((char **)arg->v, -1)) ? ch->pid : 0;
+	stats_end(StatSpawn);
 	if (arg->v == statushandler) {
 		unsetenv("BUTTON");
 		unsetenv("STATUSCMDN");
+	} else {
+		stats_launch(pid, (char **)arg->v);
 	}
 	return pid;
 }
 
+/* run cmd in a shell in the background, done gets called with its output */
+Child *
+spawnhelper(const char *cmd, void (*done)(Child *ch))
+{
+	Child *ch;
+	int fds[2];
+
+	if (pipe(fds) < 0) {
+		perror("moonwm: pipe");
+		return NULL;
+	}
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+	ch = spawnproc((char *[]){ "/bin/sh", "-c", (char *)cmd, NULL }, fds[1]);
+	close(fds[1]);
+	if (!ch) {
+		close(fds[0]);
+		return NULL;
+	}
+	fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+	ch->fd = fds[0];
+	ch->exited = done;
+	return ch;
+}
+
+/* start argv in a new session without waiting for it, with its standard
+ * output going to out unless that is -1 */
+Child *
+spawnproc(char *const argv[], int out)
+{
+	extern char **environ;
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t attr;
+	pid_t pid;
+	int err;
+
+	/* unlike fork() this does not copy our address space, and the X
+	 * connection is not inherited as it is close-on-exec (see setup()) */
+	posix_spawnattr_init(&attr);
+#ifdef POSIX_SPAWN_SETSID
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSID);
+#else
+	/* at least its own process group, like setsid() gives it */
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+#endif /* POSIX_SPAWN_SETSID */
+	posix_spawn_file_actions_init(&actions);
+	if (out != -1)
+		posix_spawn_file_actions_adddup2(&actions, out, STDOUT_FILENO);
+	err = posix_spawnp(&pid, argv[0], &actions, &attr, argv, environ);
+	posix_spawn_file_actions_destroy(&actions);
+	posix_spawnattr_destroy(&attr);
+	if (err) {
+		fprintf(stderr, "moonwm: posix_spawnp %s failed: %s\n", argv[0], strerror(err));
+		return NULL;
+	}
+	return addchild(pid);
+}
+
 int
 stackpos(const Arg *arg) {
 	int n, i;
@@ -3736,6 +4890,34 @@ stackpos(const Arg *arg) {
 		return arg->i;
 }
 
+void
+storegeoms(Monitor *m)
+{
+	Client *c;
+	Geom *g;
+	int n, t = m->pertag->curtag;
+
+	for (n = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), n++)
+		if (CMASKGET(c, M_BEINGMOVED))
+			break;
+	if (c || !n) {
+		m->pertag->ngeoms[t] = 0;
+		m->pertag->geomkeys[t] = 0;
+		return;
+	}
+
+	if (n > m->pertag->geomsizes[t]) {
+		free(m->pertag->geoms[t]);
+		m->pertag->geoms[t] = ecalloc(n, sizeof(Geom));
+		m->pertag->geomsizes[t] = n;
+	}
+	for (g = m->pertag->geoms[t], c = nexttiled(m->clients); c; c = nexttiled(c->next), g++)
+		*g = (Geom){ c, c->x, c->y, c->w, c->h, c->bw };
+	m->pertag->ngeoms[t] = n;
+	m->pertag->geomkeys[t] = layouthash(m);
+	strcpy(m->pertag->ltsymbols[t], m->ltsymbol);
+}
+
 void
 steal(const Arg *arg)
 {
@@ -3806,6 +4988,7 @@ togglebar(const Arg *arg)
 			XUnmapWindow(dpy, systray->win);
 		}
 		XConfigureWindow(dpy, systray->win, CWY, &wc);
+		systray->y = wc.y;
 	}
 	arrange(selmon);
 }
@@ -3924,7 +5107,7 @@ unfocus(Client *c, int setfocus)
 void
 unmanage(Client *c, int destroyed)
 {
-	int di;
+	int x, y, di;
 	unsigned int dui;
 	Monitor *m = c->mon;
 	Window dummy, win;
@@ -3946,6 +5129,11 @@ unmanage(Client *c, int destroyed)
 
 	detach(c);
 	detachstack(c);
+	if (c == gamer) {
+		if (destroyed)
+			gamerbypass = 0;
+		setgamer(NULL);
+	}
 	if (!destroyed) {
 		wc.border_width = c->oldbw;
 		XGrabServer(dpy); /* avoid race conditions */
@@ -3962,10 +5150,12 @@ unmanage(Client *c, int destroyed)
 	if (!s) {
 		ignorewarp = 1;
 		arrange(m);
-		/* focus under mouse instead of last focused */
-		if (XQueryPointer(dpy, root, &dummy, &win, &di, &di, &di, &di, &dui) && win)
-			focus(wintoclient(win));
-		else
+		/* focus under mouse instead of last focused, the server knows
+		 * which window is on top there */
+		if (XQueryPointer(dpy, root, &dummy, &win, &x, &y, &di, &di, &dui)) {
+			setpointer(x, y);
+			focus(win ? wintoclient(win) : NULL);
+		} else
 			focus(NULL);
 		updateclientlist();
 	}
@@ -3987,7 +5177,6 @@ unmapnotify(XEvent *e)
 		/* KLUDGE! sometimes icons occasionally unmap their windows, but do
 		 * _not_ destroy them. We map those windows back */
 		XMapRaised(dpy, c->win);
-		updatesystray();
 	}
 }
 
@@ -4109,6 +5298,19 @@ updatecurrenttags(void){
 	XChangeProperty(dpy, root, atoms[MWMCurrentTags], XA_CARDINAL, 32, PropModeReplace, (unsigned char *)data, 1);
 }
 
+/* game mode is active while a game (M_STEAM) is focused and fullscreen,
+ * it holds back bar, status, tray and title updates so they don't cost the
+ * game frames */
+void
+updategamemode(void)
+{
+	Client *c = selmon->sel;
+
+	if (!gamemode || !c || !CMASKGET(c, M_STEAM) || !CMASKGET(c, M_FULLSCREEN))
+		c = NULL;
+	setgamer(c);
+}
+
 int
 updategeom(void)
 {
@@ -4290,6 +5492,10 @@ updatestatus(void)
 {
 	Monitor* m;
 	int now;
+	if (gamer) {
+		gamedeferred |= DeferStatus;
+		return;
+	}
 	if (!window_get_textprop(dpy, root, XA_WM_NAME, rawstext, sizeof(rawstext)))
 		strcpy(stext, "moonwm-"VERSION);
 	else {
@@ -4314,8 +5520,10 @@ updatestatus(void)
 void
 updatesystrayicongeom(Client *i, int w, int h)
 {
-	int bw = 0;
+	int bw = 0, oldw, oldh;
 	if (i) {
+		oldw = i->w;
+		oldh = i->h;
 		i->h = bh;
 		if (w == h)
 			i->w = bh;
@@ -4332,6 +5540,8 @@ updatesystrayicongeom(Client *i, int w, int h)
 				i->w = (int) ((float)bh * ((float)i->w / (float)i->h));
 			i->h = bh;
 		}
+		if (i->w != oldw || i->h != oldh)
+			CMASKSET(i, M_TRAYDIRTY);
 	}
 }
 
@@ -4375,6 +5585,10 @@ updatesystray(void)
 
 	if (!showsystray)
 		return;
+	if (gamer && systray) {
+		gamedeferred |= DeferTray;
+		return;
+	}
 	if (!systray) {
 		/* init systray */
 		if (!(systray = (Systray *)calloc(1, sizeof(Systray))))
@@ -4383,6 +5597,7 @@ updatesystray(void)
 		wa.event_mask        = ButtonPressMask | ExposureMask;
 		wa.override_redirect = True;
 		wa.background_pixel  = scheme[SchemeNorm][ColTrayBg].pixel;
+		systray->dirty = 1;
 		XSelectInput(dpy, systray->win, SubstructureNotifyMask);
 		XChangeProperty(dpy, systray->win, atoms[NetSystemTrayOrientation], XA_CARDINAL, 32,
 				PropModeReplace, (unsigned char *)&atoms[NetSystemTrayOrientationHorz], 1);
@@ -4400,14 +5615,22 @@ updatesystray(void)
 			return;
 		}
 	}
+	/* only icons that moved or changed get configured again, so updates
+	 * without any change to the tray (like status updates) cost nothing */
 	for (w = 0, i = systray->icons; i; i = i->next) {
-		/* make sure the background color stays the same */
-		wa.background_pixel  = scheme[SchemeNorm][ColTrayBg].pixel;
-		XChangeWindowAttributes(dpy, i->win, CWBackPixel, &wa);
-		XMapRaised(dpy, i->win);
 		w += systrayspacing;
-		i->x = w;
-		XMoveResizeWindow(dpy, i->win, i->x, 0, i->w, i->h);
+		if (i->x != w) {
+			i->x = w;
+			CMASKSET(i, M_TRAYDIRTY);
+		}
+		if (CMASKGET(i, M_TRAYDIRTY)) {
+			/* make sure the background color stays the same */
+			wa.background_pixel  = scheme[SchemeNorm][ColTrayBg].pixel;
+			XChangeWindowAttributes(dpy, i->win, CWBackPixel, &wa);
+			XMapRaised(dpy, i->win);
+			XMoveResizeWindow(dpy, i->win, i->x, 0, i->w, i->h);
+			CMASKUNSET(i, M_TRAYDIRTY);
+		}
 		w += i->w;
 		if (i->mon != m) {
 			i->mon = m;
@@ -4416,23 +5639,29 @@ updatesystray(void)
 	}
 	w = w ? w + systrayspacing : 1;
 	x -= w;
-	XMoveResizeWindow(dpy, systray->win, x, m->by, w, bh);
 	wc.x = x; wc.y = m->by; wc.width = w; wc.height = bh;
 	wc.stack_mode = Above; wc.sibling = m->barwin;
 	if (!selmon->showbar)
 		wc.y = -bh;
+	if (!systray->dirty && systray->x == wc.x && systray->y == wc.y && systray->w == w)
+		return;
 	XConfigureWindow(dpy, systray->win, CWX|CWY|CWWidth|CWHeight|CWSibling|CWStackMode, &wc);
 	XMapWindow(dpy, systray->win);
-	XMapSubwindows(dpy, systray->win);
 	/* redraw background */
 	XSetForeground(dpy, drw->gc, scheme[SchemeNorm][ColTrayBg].pixel);
 	XFillRectangle(dpy, systray->win, drw->gc, 0, 0, w, bh);
+	systray->x = wc.x;
+	systray->y = wc.y;
+	systray->w = w;
+	systray->dirty = 0;
 	XSync(dpy, False);
 }
 
 void
 updatetitle(Client *c)
 {
+	CMASKUNSET(c, M_TITLEDIRTY);
+	c->titletime = timestamp();
 	if (!window_get_textprop(dpy, c->win, atoms[NetWMName], c->name, sizeof c->name))
 		window_get_textprop(dpy, c->win, XA_WM_NAME, c->name, sizeof c->name);
 	if (c->name[0] == '\0') /* hack to mark broken clients */
@@ -4515,6 +5744,7 @@ winpid(Window w)
 
 	xcb_generic_error_t *e = NULL;
 	xcb_res_query_client_ids_cookie_t c = xcb_res_query_client_ids(xcon, 1, &spec);
+	stats_roundtrip();
 	xcb_res_query_client_ids_reply_t *r = xcb_res_query_client_ids_reply(xcon, c, &e);
 
 	if (!r)
@@ -4609,7 +5839,7 @@ warp(const Client *c, int edge)
 	Monitor *m;
 
 	/* avoid jumping on bar or empty space */
-	if (!c || !get_pointer_pos(dpy, root, &x, &y))
+	if (!c || !getpointer(&x, &y))
 		return;
 	a = recttoclient(x, y, 1, 1);
 	m = recttomon(x, y, 1, 1);
@@ -4618,11 +5848,11 @@ warp(const Client *c, int edge)
 
 	if (!c) {
 		XWarpPointer(dpy, None, root, 0, 0, 0, 0, selmon->wx + selmon->ww/2, selmon->wy + selmon->wh/2);
+		pointermoved();
 		return;
 	}
 
-	if (!get_pointer_pos(dpy, root, &x, &y) ||
-		(x > c->x - c->bw &&
+	if ((x > c->x - c->bw &&
 		 y > c->y - c->bw &&
 		 x < c->x + c->w + c->bw*2 &&
 		 y < c->y + c->h + c->bw*2) ||
@@ -4634,6 +5864,7 @@ warp(const Client *c, int edge)
 		XWarpPointer(dpy, None, c->win, 0, 0, 0, 0, c->w, c->h);
 	else
 		XWarpPointer(dpy, None, c->win, 0, 0, 0, 0, c->w / 2, c->h / 2);
+	pointermoved();
 }
 
 Client *
@@ -4666,7 +5897,7 @@ wintomon(Window w)
 	Client *c;
 	Monitor *m;
 
-	if (w == root && get_pointer_pos(dpy, root, &x, &y))
+	if (w == root && getpointer(&x, &y))
 		return recttomon(x, y, 1, 1);
 	for (m = mons; m; m = m->next)
 		if (w == m->barwin)
@@ -4676,6 +5907,20 @@ wintomon(Window w)
 	return selmon;
 }
 
+/* repaint the tray and reconfigure every icon on the next update, after
+ * the colors or the bars changed */
+void
+systraydirty(void)
+{
+	Client *i;
+
+	if (!showsystray || !systray)
+		return;
+	systray->dirty = 1;
+	for (i = systray->icons; i; i = i->next)
+		CMASKSET(i, M_TRAYDIRTY);
+}
+
 Monitor *
 systraytomon(Monitor *m) {
 	Monitor *t;
@@ -4692,11 +5937,34 @@ systraytomon(Monitor *m) {
 	return t;
 }
 
+/* flush the trace ring buffer to tracefile, the result is published like in showstats() */
+void
+writetrace(const Arg *arg)
+{
+	char buf[PATH_MAX + 64], path[PATH_MAX];
+	int n;
+
+	userpath(path, sizeof(path), tracefile);
+	if ((n = stats_writetrace(path)) < 0)
+		snprintf(buf, sizeof(buf), "# unable to write trace to %s (moonwm.trace)\n", path);
+	else
+		snprintf(buf, sizeof(buf), "wrote %d spans to %s\n", n, path);
+	XChangeProperty(dpy, root, atoms[MWMStats], atoms[Utf8], 8,
+			PropModeReplace, (unsigned char *)buf, strlen(buf));
+}
+
 void
 xrdb(const Arg *arg)
 {
+	Client *c;
 	Monitor *m, *selmon_old;
+	unsigned int dwell = focusdwell;
+
 	settings();
+	if (!dwell != !focusdwell)
+		for (m = mons; m; m = m->next)
+			for (c = m->clients; c; c = c->next)
+				XSelectInput(dpy, c->win, CLIENTMASK);
 	for (int i = 0; i < LENGTH(colors); i++)
 		scheme[i] = drw_scm_create(drw, colors[i], 10);
 
@@ -4711,6 +5979,9 @@ xrdb(const Arg *arg)
 	focus(NULL);
 	arrange(NULL);
 	updateborderwidth();
+	systraydirty();
+	updatesystray();
+	prewarmfill();
 }
 
 void
@@ -4741,6 +6012,7 @@ main(int argc, char *argv[])
 	if (!(xcon = XGetXCBConnection(dpy)))
 		die("moonwm: cannot get xcb connection\n");
 	checkotherwm(dpy);
+	stats_init(dpy);
 	XrmInitialize();
 	settings();
 	setup();
@@ -4750,6 +6022,7 @@ main(int argc, char *argv[])
 #endif /* __OpenBSD__ */
 	scan();
 	runautostart();
+	prewarmfill();
 	run();
 	cleanup();
 	XCloseDisplay(dpy);
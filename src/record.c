@@ -0,0 +1,286 @@
+/* vim: set noet: */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+
+#include "common.h"
+#include "record.h"
+#include "util.h"
+
+#define PAYLOADSIZE		(1 << 16)
+
+typedef struct {
+	unsigned char data[PAYLOADSIZE];
+	size_t len;
+	int full; /* something did not fit, the rest of the record is dropped */
+} Payload;
+
+static void put(Payload *p, const void *data, size_t len);
+static void putatom(Payload *p, Atom atom);
+static void putprop(Payload *p, Window win, Atom prop);
+static void putstr(Payload *p, const char *str, size_t len);
+static void putu32(Payload *p, uint32_t u);
+static void putwindow(Payload *p, Window win);
+static size_t room(const Payload *p, size_t reserve);
+static void write_record(uint32_t type, Window win, const Payload *p);
+
+/* variables */
+static Display *dpy;
+static FILE *out;
+static long long start;
+static Payload payload;
+static const char *windowprops[] = {
+	"WM_NAME", "_NET_WM_NAME", "WM_CLASS", "WM_HINTS", "WM_NORMAL_HINTS",
+	"WM_TRANSIENT_FOR", "WM_PROTOCOLS", "WM_WINDOW_ROLE", "_NET_WM_WINDOW_TYPE",
+	"_NET_WM_STATE", "_MOTIF_WM_HINTS", "STEAM_GAME", "_MWM_CLIENT_TAGS",
+	"_MWM_CLIENT_MONITOR", "_MWM_CURRENT_TAGS",
+};
+
+
+/* append all of data or, once something did not fit, nothing at all, so a
+ * record is cut short at a field boundary the replay can detect */
+void
+put(Payload *p, const void *data, size_t len)
+{
+	if (p->full || len > sizeof(p->data) - p->len) {
+		p->full = 1;
+		return;
+	}
+	memcpy(p->data + p->len, data, len);
+	p->len += len;
+}
+
+void
+putatom(Payload *p, Atom atom)
+{
+	char *name = atom ? XGetAtomName(dpy, atom) : NULL;
+
+	putstr(p, name ? name : "", name ? strlen(name) : 0);
+	if (name)
+		XFree(name);
+}
+
+void
+putprop(Payload *p, Window win, Atom prop)
+{
+	Atom type = None;
+	int format = 0;
+	unsigned long i, n = 0, extra, len = 0;
+	unsigned char *data = NULL;
+	size_t mark, unit;
+
+	putatom(p, prop);
+	if (XGetWindowProperty(dpy, win, prop, 0, PAYLOADSIZE / 16, False, AnyPropertyType,
+			&type, &format, &n, &extra, &data) != Success)
+		data = NULL;
+	putatom(p, data ? type : None);
+	putu32(p, data ? format : 0);
+	if (data && type == XA_ATOM) {
+		mark = p->len;
+		putu32(p, 0);
+		/* only the names that fit, the length is filled in afterwards */
+		for (i = 0; i < n && !p->full; i++) {
+			char *name = XGetAtomName(dpy, ((Atom *)data)[i]);
+			if (name) {
+				if (strlen(name) + 1 <= room(p, 0)) {
+					put(p, name, strlen(name) + 1);
+					len += strlen(name) + 1;
+				}
+				XFree(name);
+			}
+		}
+		if (mark + sizeof(uint32_t) <= p->len)
+			memcpy(p->data + mark, &(uint32_t){ len }, sizeof(uint32_t));
+	} else if (data) {
+		/* Xlib hands out format 32 data as longs, cut to whole items */
+		unit = format == 32 ? sizeof(long) : format / 8;
+		len = MIN(n * unit, room(p, sizeof(uint32_t)) / unit * unit);
+		putu32(p, len);
+		put(p, data, len);
+	} else {
+		putu32(p, 0);
+	}
+	if (data)
+		XFree(data);
+}
+
+void
+putstr(Payload *p, const char *str, size_t len)
+{
+	uint16_t l = MIN(MIN(len, UINT16_MAX), room(p, sizeof(l)));
+
+	put(p, &l, sizeof(l));
+	put(p, str, l);
+}
+
+void
+putu32(Payload *p, uint32_t u)
+{
+	put(p, &u, sizeof(u));
+}
+
+void
+putwindow(Payload *p, Window win)
+{
+	XWindowAttributes wa;
+	RecordGeom g = {0};
+	size_t i, mark;
+	uint32_t n = 0;
+	Atom prop;
+
+	if (XGetWindowAttributes(dpy, win, &wa))
+		g = (RecordGeom){ wa.x, wa.y, wa.width, wa.height, wa.border_width,
+			wa.map_state == IsViewable };
+	put(p, &g, sizeof(g));
+	mark = p->len;
+	putu32(p, 0);
+	for (i = 0; i < LENGTH(windowprops); i++) {
+		if (!(prop = XInternAtom(dpy, windowprops[i], True)))
+			continue;
+		putprop(p, win, prop);
+		if (p->full)
+			break; /* the last one is incomplete, leave it out of the count */
+		n++;
+	}
+	if (mark + sizeof(n) <= p->len)
+		memcpy(p->data + mark, &n, sizeof(n));
+}
+
+int
+record_active(void)
+{
+	return out != NULL;
+}
+
+void
+record_event(XEvent *ev)
+{
+	Payload *p = &payload;
+	RecordConfigure rc;
+	RecordInput ri = {0};
+	Atom state;
+	int i;
+
+	if (!out)
+		return;
+	p->len = 0;
+	p->full = 0;
+	switch (ev->type) {
+	case MapRequest:
+		putwindow(p, ev->xmaprequest.window);
+		write_record(ev->type, ev->xmaprequest.window, p);
+		return;
+	case ConfigureRequest:
+		rc = (RecordConfigure){ ev->xconfigurerequest.x, ev->xconfigurerequest.y,
+			ev->xconfigurerequest.width, ev->xconfigurerequest.height,
+			ev->xconfigurerequest.border_width, ev->xconfigurerequest.detail,
+			ev->xconfigurerequest.value_mask, ev->xconfigurerequest.above };
+		put(p, &rc, sizeof(rc));
+		write_record(ev->type, ev->xconfigurerequest.window, p);
+		return;
+	case PropertyNotify:
+		putu32(p, ev->xproperty.state);
+		if (ev->xproperty.state == PropertyNewValue) {
+			putprop(p, ev->xproperty.window, ev->xproperty.atom);
+		} else {
+			putatom(p, ev->xproperty.atom);
+			putatom(p, None);
+			putu32(p, 0);
+			putu32(p, 0);
+		}
+		break;
+	case ClientMessage:
+		putatom(p, ev->xclient.message_type);
+		putu32(p, ev->xclient.format);
+		for (i = 0; i < 5; i++)
+			put(p, &(int64_t){ ev->xclient.data.l[i] }, sizeof(int64_t));
+		state = XInternAtom(dpy, "_NET_WM_STATE", True);
+		putatom(p, state && ev->xclient.message_type == state ? ev->xclient.data.l[1] : None);
+		putatom(p, state && ev->xclient.message_type == state ? ev->xclient.data.l[2] : None);
+		break;
+	case KeyPress:
+	case KeyRelease:
+		ri = (RecordInput){ ev->xkey.x_root, ev->xkey.y_root, ev->xkey.state, ev->xkey.keycode };
+		put(p, &ri, sizeof(ri));
+		break;
+	case ButtonPress:
+	case ButtonRelease:
+		ri = (RecordInput){ ev->xbutton.x_root, ev->xbutton.y_root, ev->xbutton.state, ev->xbutton.button };
+		put(p, &ri, sizeof(ri));
+		break;
+	case MotionNotify:
+		ri = (RecordInput){ ev->xmotion.x_root, ev->xmotion.y_root, ev->xmotion.state, 0 };
+		put(p, &ri, sizeof(ri));
+		break;
+	case EnterNotify:
+	case LeaveNotify:
+		ri = (RecordInput){ ev->xcrossing.x_root, ev->xcrossing.y_root, ev->xcrossing.state,
+			ev->xcrossing.detail };
+		put(p, &ri, sizeof(ri));
+		break;
+	case UnmapNotify:
+		write_record(ev->type, ev->xunmap.window, p);
+		return;
+	case DestroyNotify:
+		write_record(ev->type, ev->xdestroywindow.window, p);
+		return;
+	}
+	write_record(ev->type, ev->xany.window, p);
+}
+
+/* start recording to path with the state of root and the given windows */
+int
+record_start(Display *display, const char *path, const Window *wins, int n)
+{
+	uint32_t header[2] = { RECORDMAGIC, RECORDVERSION };
+	int i;
+
+	if (out)
+		record_stop();
+	if (!(out = fopenprivate(path)))
+		return 0;
+	dpy = display;
+	start = timestamp();
+	fwrite(header, sizeof(header), 1, out);
+	payload.len = 0;
+	payload.full = 0;
+	putwindow(&payload, DefaultRootWindow(dpy));
+	write_record(RecordWindow, DefaultRootWindow(dpy), &payload);
+	for (i = 0; i < n; i++) {
+		payload.len = 0;
+		payload.full = 0;
+		putwindow(&payload, wins[i]);
+		write_record(RecordWindow, wins[i], &payload);
+	}
+	return 1;
+}
+
+void
+record_stop(void)
+{
+	if (out)
+		fclose(out);
+	out = NULL;
+}
+
+/* bytes left in p after reserve bytes for what has to come first */
+size_t
+room(const Payload *p, size_t reserve)
+{
+	size_t left = sizeof(p->data) - p->len;
+
+	return left > reserve ? left - reserve : 0;
+}
+
+void
+write_record(uint32_t type, Window win, const Payload *p)
+{
+	RecordHeader h = { type, p->len, timestamp() - start, win };
+
+	fwrite(&h, sizeof(h), 1, out);
+	fwrite(p->data, p->len, 1, out);
+}
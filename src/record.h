@@ -0,0 +1,66 @@
+/* vim: set noet: */
+
+#ifndef RECORD_H
+#define RECORD_H
+
+/* Event recordings are a sequence of records, each one a RecordHeader
+ * followed by size bytes of payload in host byte order.  Strings are
+ * stored as a uint16_t length followed by the bytes without terminator,
+ * a property as its name, type name, a uint32_t format, a uint32_t
+ * length and its data.  Format 32 data is stored as longs, the way Xlib
+ * hands it out.  Properties of type ATOM hold the atom names separated
+ * by '\0' instead of atoms, so they can be interned again.
+ * Payloads are limited to 64k: data that does not fit is cut to what
+ * fits, and once not even a fixed size field fits the record just ends
+ * there.  Lengths always match the data that follows them.
+ *
+ * payloads:
+ *   RecordWindow, MapRequest	RecordGeom, uint32_t count, count properties
+ *   ConfigureRequest			RecordConfigure
+ *   PropertyNotify				uint32_t state, property (without data if deleted)
+ *   ClientMessage				message type name, uint32_t format, int64_t data[5],
+ *								names of data[1] and data[2] if they are atoms
+ *   key, button and pointer	RecordInput
+ *   everything else			nothing
+ *
+ * For MapRequest, ConfigureRequest, UnmapNotify and DestroyNotify the
+ * window is the one the event is about instead of the event window. */
+
+#define RECORDMAGIC		0x524d574dU /* "MWMR" in little endian */
+#define RECORDVERSION	1
+
+/* record types besides X event types */
+enum { RecordWindow = 128 }; /* state of a window when the recording started */
+
+typedef struct {
+	uint32_t type;		/* X event type or RecordWindow */
+	uint32_t size;		/* size of the payload following the header */
+	int64_t time;		/* microseconds since the recording started */
+	uint64_t window;	/* window the record is about */
+} RecordHeader;
+
+typedef struct {
+	int32_t x, y, w, h, bw;
+	uint32_t mapped;
+} RecordGeom;
+
+typedef struct {
+	int32_t x, y, w, h, bw, detail;
+	uint32_t mask;
+	uint64_t above;
+} RecordConfigure;
+
+typedef struct {
+	int32_t x, y;		/* root coordinates */
+	uint32_t state, detail;
+} RecordInput;
+
+#ifndef RECORD_READONLY
+/* function declarations */
+int record_active(void);
+void record_event(XEvent *ev);
+int record_start(Display *dpy, const char *path, const Window *wins, int n);
+void record_stop(void);
+#endif /* RECORD_READONLY */
+
+#endif
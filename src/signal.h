@@ -67,6 +67,7 @@ static Signal signals[] = {
 	{ "movex",          movex },
 	{ "movey",          movey },
 	{ "quit",           quit },
+	{ "record",         recordevents },
 	{ "resetfacts",     resetfacts },
 	{ "resizex",        resizex },
 	{ "resizey",        resizey },
@@ -79,6 +80,7 @@ static Signal signals[] = {
 	{ "setswallow",		setswallow },
 	{ "shiftview",      shiftview },
 	{ "shiftviewclients", shiftviewclients },
+	{ "stats",          showstats },
 	{ "steal",          steal },
 	{ "tag",            tag },
 	{ "tagall",         tagall },
@@ -91,6 +93,7 @@ static Signal signals[] = {
 	{ "togglelayout",   togglelayoutex },
 	{ "toggletag",      toggletag },
 	{ "toggleview",     toggleview },
+	{ "trace",          writetrace },
 	{ "view",           view },
 	{ "viewall",        viewall },
 	{ "winview",		winview },
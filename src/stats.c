@@ -0,0 +1,528 @@
+/* vim: set noet: */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <X11/Xlib.h>
+
+#include "stats.h"
+#include "util.h"
+
+typedef struct {
+	unsigned long calls, over;
+	long long total, max;
+	unsigned long requests, roundtrips, maxroundtrips;
+	unsigned long buckets[STATSBUCKETS];
+} Stat;
+
+typedef struct {
+	char name[32];
+	Stat stat;
+} NamedStat;
+
+typedef struct {
+	int pid, stat;
+	long long start;
+} Launch;
+
+typedef struct {
+	unsigned long win;
+	unsigned long events, coalesced, peak, current;
+	long long second; /* start of the second counted in current */
+	unsigned long configures, suppressed;
+	long long last; /* time of the last event counted */
+} Rate;
+
+typedef struct {
+	int id, mon;
+	long long start, duration;
+	unsigned long request, roundtrips, win;
+} Span;
+
+/* variables */
+static Display *dpy;
+static int enabled = 0, strict = 0;
+static int tracing = 0;
+static int depth = 0, skipped = 0;
+static unsigned long roundtrips = 0;
+static unsigned int budgets[StatLast];
+static Span spans[STATSDEPTH];
+static Span *trace; /* ring buffer of finished spans */
+static unsigned long tracehead = 0, tracecount = 0;
+static Stat stats[StatLast];
+static NamedStat bindings[STATSNAMED], commands[STATSNAMED];
+static int nbindings = 0, ncommands = 0, pendingbinding = -1;
+static long long pendingstart;
+static Launch launches[STATSLAUNCHES];
+static Rate rates[STATSNAMED];
+static int nrates = 0;
+static const char *names[StatLast] = {
+	[KeyPress] = "KeyPress", [KeyRelease] = "KeyRelease",
+	[ButtonPress] = "ButtonPress", [ButtonRelease] = "ButtonRelease",
+	[MotionNotify] = "MotionNotify", [EnterNotify] = "EnterNotify",
+	[LeaveNotify] = "LeaveNotify", [FocusIn] = "FocusIn", [FocusOut] = "FocusOut",
+	[KeymapNotify] = "KeymapNotify", [Expose] = "Expose",
+	[GraphicsExpose] = "GraphicsExpose", [NoExpose] = "NoExpose",
+	[VisibilityNotify] = "VisibilityNotify", [CreateNotify] = "CreateNotify",
+	[DestroyNotify] = "DestroyNotify", [UnmapNotify] = "UnmapNotify",
+	[MapNotify] = "MapNotify", [MapRequest] = "MapRequest",
+	[ReparentNotify] = "ReparentNotify", [ConfigureNotify] = "ConfigureNotify",
+	[ConfigureRequest] = "ConfigureRequest", [GravityNotify] = "GravityNotify",
+	[ResizeRequest] = "ResizeRequest", [CirculateNotify] = "CirculateNotify",
+	[CirculateRequest] = "CirculateRequest", [PropertyNotify] = "PropertyNotify",
+	[SelectionClear] = "SelectionClear", [SelectionRequest] = "SelectionRequest",
+	[SelectionNotify] = "SelectionNotify", [ColormapNotify] = "ColormapNotify",
+	[ClientMessage] = "ClientMessage", [MappingNotify] = "MappingNotify",
+	[GenericEvent] = "GenericEvent",
+	[StatArrange] = "arrange", [StatDrawbar] = "drawbar", [StatFocus] = "focus",
+	[StatLayout] = "layout", [StatManage] = "manage", [StatRestack] = "restack",
+	[StatSpawn] = "spawn", [StatSync] = "XSync",
+};
+
+
+/* snprintf() to the end of buf, len ends up at size if it got truncated */
+static void
+append(char *buf, size_t size, size_t *len, const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	if (*len >= size)
+		return;
+	va_start(ap, fmt);
+	n = vsnprintf(buf + *len, size - *len, fmt, ap);
+	va_end(ap);
+	*len = n < 0 ? size : MIN(*len + n, size);
+}
+
+static void
+account(Stat *s, long long d)
+{
+	int i;
+
+	for (i = 0; i < STATSBUCKETS - 1 && d >= 1LL << i; i++);
+	s->calls++;
+	s->total += d;
+	s->max = MAX(d, s->max);
+	s->buckets[i]++;
+}
+
+/* upper bound of the bucket containing the given fraction of all calls */
+static long long
+percentile(const Stat *s, double fraction)
+{
+	unsigned long n = 0;
+	int i;
+
+	for (i = 0; i < STATSBUCKETS - 1; i++)
+		if ((n += s->buckets[i]) >= s->calls * fraction)
+			break;
+	return i < STATSBUCKETS - 1 ? MIN(1LL << i, s->max) : s->max;
+}
+
+static void
+formatnamed(char *buf, size_t size, size_t *len, const NamedStat *table, int n,
+		const char *kind, const char *what)
+{
+	char label[64];
+	const Stat *s;
+	int i;
+
+	if (n)
+		append(buf, size, len, "# %-16s %9s %10s %7s %7s %7s %7s  %s\n", kind,
+				"calls", "total", "mean", "p50", "p99", "max", what);
+	for (i = 0; i < n; i++) {
+		s = &table[i].stat;
+		snprintf(label, sizeof(label), "%s:%s", kind, table[i].name);
+		if (s->calls)
+			append(buf, size, len, "%-18s %9lu %10lld %7lld %7lld %7lld %7lld\n",
+					label, s->calls, s->total, s->total / (long long)s->calls,
+					percentile(s, 0.5), percentile(s, 0.99), s->max);
+	}
+}
+
+/* index of name in table, added if it is not in there yet, or -1 if it is full */
+static int
+named(NamedStat *table, int *n, const char *name)
+{
+	int i;
+
+	for (i = 0; i < *n && strcmp(table[i].name, name); i++);
+	if (i == *n) {
+		if (*n == STATSNAMED)
+			return -1;
+		snprintf(table[i].name, sizeof(table[i].name), "%s", name);
+		(*n)++;
+	}
+	return i;
+}
+
+/* arguments of the innermost running span, shown in traces */
+void
+stats_args(unsigned long win, int mon)
+{
+	if (depth && !skipped) {
+		spans[depth - 1].win = win;
+		spans[depth - 1].mon = mon;
+	}
+}
+
+void
+stats_begin(int id)
+{
+	Span *sp;
+
+	if (!enabled && !tracing)
+		return;
+	if (depth == STATSDEPTH) {
+		skipped++;
+		return;
+	}
+	sp = &spans[depth++];
+	sp->id = id;
+	sp->win = 0;
+	sp->mon = -1;
+	sp->request = NextRequest(dpy);
+	sp->roundtrips = roundtrips;
+	sp->start = timestamp();
+}
+
+void
+stats_enable(int enable, int strictmode)
+{
+	enabled = enable && dpy;
+	strict = strictmode;
+	depth = skipped = 0;
+	pendingbinding = -1;
+}
+
+/* for callers that would have to work to pass in what is measured */
+int
+stats_enabled(void)
+{
+	return enabled;
+}
+
+void
+stats_end(int id)
+{
+	Span *sp;
+	Stat *s;
+	long long d;
+	unsigned long rt;
+
+	if ((!enabled && !tracing) || !depth)
+		return;
+	if (skipped) {
+		skipped--;
+		return;
+	}
+	sp = &spans[--depth];
+	if (sp->id != id || id < 0 || id >= StatLast)
+		return;
+	d = timestamp() - sp->start;
+	if (tracing) {
+		sp->duration = d;
+		trace[tracehead] = *sp;
+		tracehead = (tracehead + 1) % TRACESIZE;
+		tracecount = MIN(tracecount + 1, TRACESIZE);
+	}
+	if (!enabled)
+		return;
+	s = &stats[id];
+	rt = roundtrips - sp->roundtrips;
+	account(s, d);
+	s->requests += NextRequest(dpy) - sp->request;
+	s->roundtrips += rt;
+	s->maxroundtrips = MAX(rt, s->maxroundtrips);
+	if (budgets[id] && rt > budgets[id]) {
+		s->over++;
+		if (strict)
+			die("moonwm: %s took %lu round trips, its budget is %u\n", names[id], rt, budgets[id]);
+	}
+}
+
+size_t
+stats_format(char *buf, size_t size)
+{
+	size_t len = 0;
+	int i, j;
+	const Stat *s;
+
+	if (!size)
+		return 0;
+	buf[0] = '\0';
+	if (!enabled)
+		append(buf, size, &len, "# statistics are disabled (moonwm.stats)\n");
+	append(buf, size, &len, "%-18s %9s %10s %7s %7s %7s %7s %7s %7s %6s %6s %6s  %s\n",
+			"# name", "calls", "total", "mean", "p50", "p99", "max",
+			"reqs", "rtrips", "rtmax", "budget", "over",
+			"histogram (bucket:calls, bucket i < 2^i us)");
+	for (i = 0; i < StatLast; i++) {
+		s = &stats[i];
+		if (!s->calls || !names[i])
+			continue;
+		append(buf, size, &len, "%-18s %9lu %10lld %7lld %7lld %7lld %7lld %7.1f %7.2f %6lu %6u %6lu ",
+				names[i], s->calls, s->total, s->total / (long long)s->calls,
+				percentile(s, 0.5), percentile(s, 0.99), s->max,
+				(double)s->requests / s->calls, (double)s->roundtrips / s->calls,
+				s->maxroundtrips, budgets[i], s->over);
+		for (j = 0; j < STATSBUCKETS; j++)
+			if (s->buckets[j])
+				append(buf, size, &len, " %d:%lu", j, s->buckets[j]);
+		append(buf, size, &len, "\n");
+	}
+	formatnamed(buf, size, &len, bindings, nbindings, "key",
+			"(keypress until the server processed its drawing)");
+	formatnamed(buf, size, &len, commands, ncommands, "launch",
+			"(spawn until its first window is managed)");
+	if (nrates)
+		append(buf, size, &len, "# %-16s %9s %10s %7s %10s %10s  %s\n", "client",
+				"events", "coalesced", "peak/s", "configures", "suppressed",
+				"(property changes and configure requests of client windows)");
+	for (i = 0; i < nrates; i++)
+		append(buf, size, &len, "client:0x%-9lx %9lu %10lu %7lu %10lu %10lu\n", rates[i].win,
+				rates[i].events, rates[i].coalesced, MAX(rates[i].peak, rates[i].current),
+				rates[i].configures, rates[i].suppressed);
+	return MIN(len, size - 1);
+}
+
+void
+stats_init(Display *display)
+{
+	dpy = display;
+}
+
+/* the key binding started by the last stats_keypress() has been drawn */
+void
+stats_keydone(void)
+{
+	if (pendingbinding >= 0)
+		account(&bindings[pendingbinding].stat, timestamp() - pendingstart);
+	pendingbinding = -1;
+}
+
+int
+stats_keypending(void)
+{
+	return pendingbinding >= 0;
+}
+
+/* a key binding is about to run */
+void
+stats_keypress(const char *name)
+{
+	int i;
+
+	if (!enabled || (i = named(bindings, &nbindings, name)) < 0)
+		return;
+	/* a binding pressed before the previous one got drawn ends it */
+	stats_keydone();
+	pendingbinding = i;
+	pendingstart = timestamp();
+}
+
+/* pid was spawned to run argv, measure until it maps its first window */
+void
+stats_launch(int pid, char *const argv[])
+{
+	char name[32];
+	const char *s;
+	Launch *l, *oldest = &launches[0];
+	int i;
+
+	if (!enabled || pid <= 0)
+		return;
+	/* name shell commands by their first word */
+	if (argv[1] && argv[2] && !strcmp(argv[1], "-c"))
+		snprintf(name, sizeof(name), "%.*s", (int)strcspn(argv[2], " \t;|&"), argv[2]);
+	else
+		snprintf(name, sizeof(name), "%s", (s = strrchr(argv[0], '/')) ? s + 1 : argv[0]);
+	if ((i = named(commands, &ncommands, name)) < 0)
+		return;
+	for (l = launches; l < launches + STATSLAUNCHES; l++)
+		if (!l->pid || l->start < oldest->start)
+			oldest = l;
+	*oldest = (Launch){ pid, i, timestamp() };
+}
+
+int
+stats_launchpending(void)
+{
+	long long t = timestamp();
+	int i, n = 0;
+
+	for (i = 0; i < STATSLAUNCHES; i++) {
+		if (launches[i].pid && t - launches[i].start > LAUNCHTIMEOUT)
+			launches[i].pid = 0;
+		n += launches[i].pid != 0;
+	}
+	return n;
+}
+
+/* a window of pid got managed, returns whether pid was a pending launch */
+int
+stats_managed(int pid)
+{
+	int i;
+
+	for (i = 0; i < STATSLAUNCHES; i++) {
+		if (launches[i].pid && launches[i].pid == pid) {
+			account(&commands[launches[i].stat].stat, timestamp() - launches[i].start);
+			launches[i].pid = 0;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* the rates of win, added if it is not in there yet; NULL if the table is
+ * full of clients that were busy recently, so newcomers can not push the
+ * noisy ones out of it */
+static Rate *
+rate(unsigned long win)
+{
+	Rate *r, *idlest = &rates[0];
+	long long t = timestamp();
+
+	for (r = rates; r < rates + nrates && r->win != win; r++)
+		if (r->last < idlest->last)
+			idlest = r;
+	if (r == rates + nrates) {
+		if (nrates < STATSNAMED)
+			nrates++;
+		else if (t - idlest->last >= RATEIDLE)
+			r = idlest;
+		else
+			return NULL;
+		*r = (Rate){ .win = win };
+	}
+	r->last = t;
+	return r;
+}
+
+/* the client window win asked to be configured, suppressed if moonwm
+ * ignored it as part of a loop */
+void
+stats_configure(unsigned long win, int suppressed)
+{
+	Rate *r;
+
+	if (!enabled || !(r = rate(win)))
+		return;
+	r->configures++;
+	r->suppressed += suppressed != 0;
+}
+
+/* a property of the client window win changed, coalesced if moonwm only
+ * handles it later together with further changes */
+void
+stats_property(unsigned long win, int coalesced)
+{
+	long long t;
+	Rate *r;
+
+	if (!enabled || !(r = rate(win)))
+		return;
+	t = r->last;
+	if (t - r->second >= 1000000) {
+		r->peak = MAX(r->peak, r->current);
+		r->current = 0;
+		r->second = t;
+	}
+	r->current++;
+	r->events++;
+	r->coalesced += coalesced != 0;
+}
+
+void
+stats_print(FILE *f)
+{
+	char buf[STATSBUFSIZE];
+
+	stats_format(buf, sizeof(buf));
+	fputs(buf, f);
+}
+
+void
+stats_reset(void)
+{
+	memset(stats, 0, sizeof(stats));
+	memset(bindings, 0, sizeof(bindings));
+	memset(commands, 0, sizeof(commands));
+	memset(launches, 0, sizeof(launches));
+	memset(rates, 0, sizeof(rates));
+	nbindings = ncommands = nrates = 0;
+	pendingbinding = -1;
+}
+
+void
+stats_roundtrip(void)
+{
+	roundtrips++;
+}
+
+/* the name of an event type or code path, NULL if it has none */
+const char *
+stats_name(int id)
+{
+	return id >= 0 && id < StatLast ? names[id] : NULL;
+}
+
+void
+stats_setbudget(int id, unsigned int rt)
+{
+	if (id >= 0 && id < StatLast)
+		budgets[id] = rt;
+}
+
+int
+stats_sync(Display *display, Bool discard)
+{
+	int ret;
+
+	roundtrips++;
+	stats_begin(StatSync);
+	ret = (XSync)(display, discard);
+	stats_end(StatSync);
+	return ret;
+}
+
+void
+stats_trace(int enable)
+{
+	if (enable && !trace)
+		trace = ecalloc(TRACESIZE, sizeof(Span));
+	tracing = enable && trace && dpy;
+	depth = skipped = 0;
+}
+
+/* write the spans in the ring buffer as trace event json and empty it,
+ * returns the number of spans written or -1 on error */
+int
+stats_writetrace(const char *path)
+{
+	FILE *f;
+	const Span *sp;
+	unsigned long i;
+	int n = 0, pid = getpid();
+
+	if (!trace || !(f = fopenprivate(path)))
+		return -1;
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", f);
+	for (i = 0; i < tracecount; i++) {
+		sp = &trace[(tracehead + TRACESIZE - tracecount + i) % TRACESIZE];
+		fprintf(f, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+				"\"ts\":%lld,\"dur\":%lld,\"args\":{\"window\":\"0x%lx\",\"monitor\":%d}}",
+				n++ ? "," : "", names[sp->id] ? names[sp->id] : "unknown",
+				sp->id < LASTEvent ? "event" : "wm", pid, pid,
+				sp->start, sp->duration, sp->win, sp->mon);
+	}
+	fputs("\n]}\n", f);
+	tracecount = 0;
+	if (fclose(f))
+		return -1;
+	return n;
+}
@@ -0,0 +1,73 @@
+/* vim: set noet: */
+
+#ifndef STATS_H
+#define STATS_H
+
+/* latency buckets, bucket i counts calls taking less than 2^i microseconds,
+ * the last one everything slower */
+#define STATSBUCKETS	24
+/* maximum nesting of measured code paths */
+#define STATSDEPTH		16
+/* number of distinct key bindings and spawned commands measured */
+#define STATSNAMED		64
+/* number of spawned processes waited for to map a window, and for how long */
+#define STATSLAUNCHES	32
+#define LAUNCHTIMEOUT	(30 * 1000000LL)
+/* how long a client has to be quiet before a new one may take its rates */
+#define RATEIDLE		(10 * 1000000LL)
+/* enough for all lines of stats_format() */
+#define STATSBUFSIZE	((StatLast + 3 * STATSNAMED) * 256)
+/* number of spans kept for tracing, older ones get overwritten */
+#define TRACESIZE		(1 << 16)
+
+/* measured code paths besides the event handlers (indexed by event type) */
+enum { StatArrange = LASTEvent, StatDrawbar, StatFocus, StatLayout, StatManage, StatRestack,
+		StatSpawn, StatSync, StatLast };
+
+/* function declarations */
+void stats_args(unsigned long win, int mon);
+void stats_begin(int id);
+void stats_enable(int enable, int strict);
+int stats_enabled(void);
+void stats_end(int id);
+size_t stats_format(char *buf, size_t size);
+void stats_init(Display *dpy);
+void stats_keydone(void);
+int stats_keypending(void);
+void stats_keypress(const char *name);
+void stats_launch(int pid, char *const argv[]);
+int stats_launchpending(void);
+int stats_managed(int pid);
+void stats_configure(unsigned long win, int suppressed);
+void stats_property(unsigned long win, int coalesced);
+void stats_print(FILE *f);
+void stats_reset(void);
+void stats_roundtrip(void);
+const char *stats_name(int id);
+void stats_setbudget(int id, unsigned int roundtrips);
+int stats_sync(Display *dpy, Bool discard);
+void stats_trace(int enable);
+int stats_writetrace(const char *path);
+
+/* count the Xlib calls that wait for a reply of the server */
+#define XGetClassHint(...)			(stats_roundtrip(), XGetClassHint(__VA_ARGS__))
+#define XGetInputFocus(...)			(stats_roundtrip(), XGetInputFocus(__VA_ARGS__))
+#define XGetModifierMapping(...)	(stats_roundtrip(), XGetModifierMapping(__VA_ARGS__))
+#define XGetSelectionOwner(...)		(stats_roundtrip(), XGetSelectionOwner(__VA_ARGS__))
+#define XGetTextProperty(...)		(stats_roundtrip(), XGetTextProperty(__VA_ARGS__))
+#define XGetTransientForHint(...)	(stats_roundtrip(), XGetTransientForHint(__VA_ARGS__))
+#define XGetWindowAttributes(...)	(stats_roundtrip(), XGetWindowAttributes(__VA_ARGS__))
+#define XGetWindowProperty(...)		(stats_roundtrip(), XGetWindowProperty(__VA_ARGS__))
+#define XGetWMHints(...)			(stats_roundtrip(), XGetWMHints(__VA_ARGS__))
+#define XGetWMNormalHints(...)		(stats_roundtrip(), XGetWMNormalHints(__VA_ARGS__))
+#define XGetWMProtocols(...)		(stats_roundtrip(), XGetWMProtocols(__VA_ARGS__))
+#define XGrabPointer(...)			(stats_roundtrip(), XGrabPointer(__VA_ARGS__))
+#define XQueryPointer(...)			(stats_roundtrip(), XQueryPointer(__VA_ARGS__))
+#define XQueryTree(...)				(stats_roundtrip(), XQueryTree(__VA_ARGS__))
+#define XSync(...)					stats_sync(__VA_ARGS__)
+#ifdef XINERAMA
+#define XineramaIsActive(...)		(stats_roundtrip(), XineramaIsActive(__VA_ARGS__))
+#define XineramaQueryScreens(...)	(stats_roundtrip(), XineramaQueryScreens(__VA_ARGS__))
+#endif /* XINERAMA */
+
+#endif
@@ -1,8 +1,11 @@
 /* See LICENSE file for copyright and license details. */
+#include <fcntl.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "util.h"
 
@@ -33,3 +36,45 @@ die(const char *fmt, ...) {
 
 	exit(1);
 }
+
+/* open path for writing without following a link planted there, readable
+ * only by the user */
+FILE *
+fopenprivate(const char *path)
+{
+	FILE *f;
+	int fd;
+
+	if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0600)) < 0)
+		return NULL;
+	if (!(f = fdopen(fd, "w")))
+		close(fd);
+	return f;
+}
+
+/* monotonic timestamp in microseconds */
+long long
+timestamp(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+		return 0;
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* name in $XDG_RUNTIME_DIR, or $HOME without one, unless it is absolute */
+void
+userpath(char *buf, size_t size, const char *name)
+{
+	const char *dir;
+
+	if (name[0] == '/')
+		snprintf(buf, size, "%s", name);
+	else if ((dir = getenv("XDG_RUNTIME_DIR")) && dir[0])
+		snprintf(buf, size, "%s/%s", dir, name);
+	else if ((dir = getenv("HOME")))
+		snprintf(buf, size, "%s/%s", dir, name);
+	else
+		snprintf(buf, size, "%s", name);
+}
@@ -6,3 +6,6 @@
 
 void die(const char *fmt, ...);
 void *ecalloc(size_t nmemb, size_t size);
+FILE *fopenprivate(const char *path);
+long long timestamp(void);
+void userpath(char *buf, size_t size, const char *name);
@@ -15,6 +15,7 @@
 
 #include "xwrappers.h"
 #include "common.h"
+#include "stats.h"
 #include "util.h"
 
 /* variables */
@@ -71,6 +72,7 @@ get_atoms(Display *dpy)
 		atoms[NetWMDemandsAttention] = XInternAtom(dpy, "_NET_WM_DEMANDS_ATTENTION", False);
 		atoms[NetWMDesktop] = XInternAtom(dpy, "_NET_WM_DESKTOP", False);
 		atoms[NetWMMoveResize] = XInternAtom(dpy, "_NET_WM_MOVE_RESIZE", False);
+		atoms[NetWMBypassCompositor] = XInternAtom(dpy, "_NET_WM_BYPASS_COMPOSITOR", False);
 
 		atoms[Manager] = XInternAtom(dpy, "MANAGER", False);
 		atoms[Xembed] = XInternAtom(dpy, "_XEMBED", False);
@@ -80,6 +82,8 @@ get_atoms(Display *dpy)
 		atoms[MWMCurrentTags] = XInternAtom(dpy, "_MWM_CURRENT_TAGS", False);
 		atoms[MWMClientMonitor] = XInternAtom(dpy, "_MWM_CLIENT_MONITOR", False);
 		atoms[MWMBorderWidth] = XInternAtom(dpy, "_MWM_BORDER_WIDTH", False);
+		atoms[MWMStats] = XInternAtom(dpy, "_MWM_STATS", False);
+		atoms[MWMCommand] = XInternAtom(dpy, "_MWM_COMMAND", False);
 		atoms[SteamGame] = XInternAtom(dpy, "STEAM_GAME", False);
 
 		atoms[KDENetWMWindowTypeOverride] = XInternAtom(dpy, "_KDE_NET_WM_WINDOW_TYPE_OVERRIDE", False);
@@ -11,11 +11,11 @@ enum { NetSupported, NetWMDemandsAttention, NetWMName, NetWMState, NetWMCheck,
 	   	NetWMFullscreen, NetActiveWindow, NetWMWindowType, NetWMWindowTypeDock, NetWMDesktop,
 	   	NetWMWindowTypeDesktop, NetWMWindowTypeDialog, NetClientList, NetClientListStacking,
 	   	NetDesktopNames, NetDesktopViewport, NetNumberOfDesktops,
-	   	NetCurrentDesktop, /* EWMH atoms */
+	   	NetCurrentDesktop, NetWMBypassCompositor, /* EWMH atoms */
 
 		Manager, Xembed, XembedInfo,  /* Xembed atoms */
 
-		SteamGame, MWMClientTags, MWMCurrentTags, MWMClientMonitor, MWMBorderWidth, MWMLast, /* MoonWM atoms */
+		SteamGame, MWMClientTags, MWMCurrentTags, MWMClientMonitor, MWMBorderWidth, MWMStats, MWMCommand, MWMLast, /* MoonWM atoms */
 
 		WMProtocols, WMDelete, WMState, WMTakeFocus, WMChangeState,
 		WMWindowRole, /* default atoms */